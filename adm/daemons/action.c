@@ -18,8 +18,11 @@
  * - Plural handling and article management
  * - Target-specific message delivery
  *
+ * Message templates are compiled once into token lists and kept in a
+ * bounded LRU cache, so repeated actions only pay for the substitutions.
+ *
  * @created Unknown
- * @last_modified 2024-08-07 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  */
 
 inherit STD_DAEMON;
@@ -218,6 +221,136 @@ mixed *handle_ob(mixed ob, string res, mapping has) {
   return ({ res, bit });
 }
 
+// Maximum number of compiled message templates kept in the cache
+#define TEMPLATE_CACHE_SIZE 256
+#define TEMPLATE_TOKEN "\\$[NnVvTtPpOoRrBb][a-z0-9]*"
+
+// Compiled token layout
+#define TOK_TYPE    0
+#define TOK_SUBJ    1
+#define TOK_NUM     2
+#define TOK_STR     3
+#define TOK_LITERAL 4
+
+private nosave mapping _templates = ([ ]);
+private nosave mapping _template_used = ([ ]);
+private nosave int _template_tick = 0;
+private nosave int _template_hits = 0;
+private nosave int _template_misses = 0;
+private nosave int _template_evictions = 0;
+
+/**
+ * Parses a message template into a compiled token list.
+ *
+ * The first element is the literal text preceding the first token. Every
+ * following element describes one substitution: its type character, the
+ * subject and participant indices, the modifier suffix and the literal text
+ * that follows it. Verb contractions are folded in here so that rendering
+ * never has to look at the template text again.
+ *
+ * @param {string} msg - The message template
+ * @returns {mixed*} The compiled template
+ */
+private mixed *compile_message(string msg) {
+  mixed *fmt = reg_assoc(msg, ({ TEMPLATE_TOKEN }), ({ 1 }))[0];
+  mixed *tokens = allocate((sizeof(fmt) + 1) / 2);
+  int i, j;
+
+  tokens[0] = fmt[0];
+
+  for(i = 1, j = 1; i < sizeof(fmt); i += 2, j++) {
+    string tok = fmt[i], str, literal = fmt[i+1];
+    int c = tok[1], subj, num;
+
+    if(sizeof(tok) > 2 && tok[2] < 'a') {
+      if(sizeof(tok) > 3 && tok[3] < 'a') {
+        subj = tok[2] - '0';
+        num = tok[3] - '0';
+        str = tok[4..];
+      } else {
+        subj = 0;
+        num = tok[2] - '0';
+        str = tok[3..];
+      }
+    } else {
+      subj = 0;
+      num = ((c == 't' || c == 'T') ? 1 : 0); // target defaults to 1, not zero
+      str = tok[2..];
+    }
+
+    /* hack for contractions */
+    if((c == 'v' || c == 'V') && literal[0..2] == "'t ") {
+      str += "'t";
+      literal = literal[2..];
+    }
+
+    tokens[j] = ({ c, subj, num, str, literal });
+  }
+
+  return tokens;
+}
+
+/**
+ * Returns the compiled form of a message template, compiling and caching
+ * it if necessary. When the cache is full, the least recently used quarter
+ * of it is evicted.
+ *
+ * @param {string} msg - The message template
+ * @returns {mixed*} The compiled template
+ */
+private mixed *query_compiled(string msg) {
+  mixed *compiled = _templates[msg];
+
+  _template_used[msg] = ++_template_tick;
+
+  if(compiled) {
+    _template_hits++;
+    return compiled;
+  }
+
+  _template_misses++;
+
+  if(sizeof(_templates) >= TEMPLATE_CACHE_SIZE) {
+    string *order = sort_array(keys(_templates),
+      (: _template_used[$1] - _template_used[$2] :));
+
+    foreach(string old in order[0..TEMPLATE_CACHE_SIZE / 4 - 1]) {
+      map_delete(_templates, old);
+      map_delete(_template_used, old);
+      _template_evictions++;
+    }
+  }
+
+  return _templates[msg] = compile_message(msg);
+}
+
+/**
+ * Returns statistics about the compiled template cache.
+ *
+ * @returns {mapping} Cache size, capacity, hits, misses and evictions
+ */
+mapping query_cache_stats() {
+  return ([
+    "size"      : sizeof(_templates),
+    "capacity"  : TEMPLATE_CACHE_SIZE,
+    "hits"      : _template_hits,
+    "misses"    : _template_misses,
+    "evictions" : _template_evictions,
+  ]);
+}
+
+/**
+ * Empties the compiled template cache and resets its counters.
+ */
+void clear_cache() {
+  _templates = ([ ]);
+  _template_used = ([ ]);
+  _template_tick = 0;
+  _template_hits = 0;
+  _template_misses = 0;
+  _template_evictions = 0;
+}
+
 //:FUNCTION compose_message
 //The lowest level message composing function; it is passed the object
 //for whom the message is wanted, the message string, the array of people
@@ -227,7 +360,8 @@ mixed *handle_ob(mixed ob, string res, mapping has) {
  * Composes a complex message for a specific viewer.
  *
  * This function handles all the substitutions and grammar rules for composing
- * a message appropriate for the viewing object.
+ * a message appropriate for the viewing object. The template is parsed once
+ * and cached; only the substitutions are evaluated per viewer.
  *
  * @param {object} forwhom - The object viewing the message
  * @param {string} msg - The message template with substitution tokens
@@ -243,9 +377,9 @@ mixed *handle_ob(mixed ob, string res, mapping has) {
  */
 varargs string compose_message(object forwhom, string msg, object *who, mixed *obs...) {
   mixed ob;
-  mixed *fmt;
+  mixed *compiled;
   string res;
-  int i;
+  int i, sz;
   int c;
   int num, subj;
   string str;
@@ -253,30 +387,19 @@ varargs string compose_message(object forwhom, string msg, object *who, mixed *o
   mapping has = ([]);
   mixed tmp;
 
-  fmt = reg_assoc(msg, ({ "\\$[NnVvTtPpOoRrBb][a-z0-9]*" }), ({ 1 }));
-  fmt = fmt[0] ; // ignore the token info for now
+  compiled = query_compiled(msg);
 
-  res = fmt[0];
-  i = 1;
+  res = compiled[0];
+  sz = sizeof(compiled);
 
-  while(i < sizeof(fmt)) {
-    c = fmt[i][1];
-    if(fmt[i][2] && fmt[i][2] < 'a') {
-      if(fmt[i][3] && fmt[i][3] < 'a') {
-        printf(" fmt[i][3] && fmt[i][3] < 'a'\n");
-        subj = fmt[i][2] - '0';
-        num = fmt[i][3] - '0';
-        str = fmt[i][4.. < 0];
-      } else {
-        subj = 0;
-        num = fmt[i][2] - '0';
-        str = fmt[i][3.. < 0];
-      }
-    } else {
-      subj = 0;
-      num = ((c == 't' || c == 'T') ? 1 : 0); // target defaults to 1, not zero
-      str = fmt[i][2.. < 0];
-    }
+  for(i = 1; i < sz; i++) {
+    mixed *tok = compiled[i];
+
+    c = tok[TOK_TYPE];
+    subj = tok[TOK_SUBJ];
+    num = tok[TOK_NUM];
+    str = tok[TOK_STR];
+    bit = 0;
 
     switch(c) {
       case 'o':
@@ -373,12 +496,6 @@ varargs string compose_message(object forwhom, string msg, object *who, mixed *o
 
       case 'v':
       case 'V':
-        /* hack for contractions */
-        if(i + 1 < sizeof(fmt) && fmt[i+1][0..2] == "'t ") {
-          str += "'t";
-          fmt[i+1] = fmt[i+1][2..];
-        }
-
         /* hack for to be */
         if(str == "is" || str == "am" || str == "are") {
           if(num >= sizeof(who) || who[num]==forwhom || who[num]->query_gender() == "other")
@@ -445,8 +562,7 @@ varargs string compose_message(object forwhom, string msg, object *who, mixed *o
     if(c < 'a')
       bit = capitalize(bit);
 
-    res += bit + fmt[i+1];
-    i += 2;
+    res += bit + tok[TOK_LITERAL];
   }
 
   return append(res, "\n");
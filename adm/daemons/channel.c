@@ -321,6 +321,8 @@ void rec_msg(string channel, string user, string msg) {
   listeners = channels[channel]["listeners"];
   listeners -= ({ 0 });
   if(listeners) {
+    object *targets = ({ });
+
     for(i = 0; i < sizeof(listeners); i ++) {
       ob = find_living(listeners[i]);
 
@@ -330,7 +332,10 @@ void rec_msg(string channel, string user, string msg) {
       }
 
       tell(ob, msg);
-      GMCP_D->send_gmcp(ob, GMCP_PKG_COMM_CHANNEL_TEXT, payload);
+      targets += ({ ob });
     }
+
+    // One broadcast, so the payload is only encoded once.
+    GMCP_D->broadcast_gmcp(targets, GMCP_PKG_COMM_CHANNEL_TEXT, payload);
   }
 }
@@ -5,11 +5,17 @@
  * Provides functionality for colour code substitution, text wrapping, and
  * colour transformations.
  *
+ * Tagged strings are compiled once into a span list of plain text and tags,
+ * cached by the input string, and emitted for whichever colour mode the
+ * caller asks for without being scanned again.
+ *
  * @created 2022-08-22 - Gesslar
- * @last_modified 2024-03-11 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2022-08-22 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Single-pass tag compiler with cached span lists
+ * 2026-10-17 - Gesslar - Keep near-white greys inside the 256-colour range
  */
 
 #include <colour.h>
@@ -23,6 +29,10 @@ int colour_to_greyscale(int colour_code);
 int colourp(string text);
 private int too_dark_check();
 private string cached(string tag);
+private mixed *compile_colour(string text);
+private string tag_sequence(string tag, int mode);
+private int nearest_ansi16(int *rgb);
+private int valid_tag(string inner);
 private void normalize_hex(string ref hex);
 public int *colour_to_rgb(int colour_code);
 public int rgb_to_colour(int r, int g, int b);
@@ -44,6 +54,36 @@ private nosave float minimum_luminance;
 private nosave mapping attributes = ([ ]);
 private nosave mapping cache = ([]);
 
+// Emission modes
+#define EMIT_OFF        0
+#define EMIT_16         1
+#define EMIT_256        2
+#define EMIT_TRUECOLOUR 3
+
+// Upper bound on cached span lists before the cache is flushed
+#define SPAN_CACHE_MAX  2048
+// Strings longer than this are compiled but not cached
+#define SPAN_CACHE_MAX_LENGTH 8192
+
+// The longest tag body, "RRGGBB"
+#define TAG_MAX_INNER   6
+
+/**
+ * text -> ({ text0, tag1, text1, ..., tagN, textN }), with each tag in an
+ * odd slot as the full "{{...}}" tag.
+ */
+private nosave mapping spans = ([ ]);
+// mode -> ([ tag : sequence ]) for the modes other than truecolour
+private nosave mapping mode_cache = ([ EMIT_16 : ([ ]), EMIT_256 : ([ ]) ]);
+private nosave mapping modes = ([
+  "on"         : EMIT_TRUECOLOUR,
+  "truecolour" : EMIT_TRUECOLOUR,
+  "truecolor"  : EMIT_TRUECOLOUR,
+  "256"        : EMIT_256,
+  "16"         : EMIT_16,
+]);
+private nosave int span_hits, span_misses;
+
 private nosave mixed *ansi_rgb = ({
   ({ 0, 0, 0 }), ({ 128, 0, 0 }), ({ 0, 128, 0 }), ({ 128, 128, 0 }),
   ({ 0, 0, 128 }), ({ 128, 0, 128 }), ({ 0, 128, 128 }), ({ 192, 192, 192 }),
@@ -96,6 +136,14 @@ private string cached(string tag) {
  * @returns {void}
  */
 void cache_attributes() {
+  attributes = ([
+    "{{res}}" : 1, "{{RES}}" : 1,
+    "{{bl0}}" : 1, "{{bl1}}" : 1, "{{di0}}" : 1, "{{di1}}" : 1,
+    "{{fl0}}" : 1, "{{fl1}}" : 1, "{{it0}}" : 1, "{{it1}}" : 1,
+    "{{ol0}}" : 1, "{{ol1}}" : 1, "{{re0}}" : 1, "{{re1}}" : 1,
+    "{{st0}}" : 1, "{{st1}}" : 1, "{{ul0}}" : 1, "{{ul1}}" : 1,
+  ]);
+
   cache += ([
     "{{res}}" : "\e[0m",  // reset
     "{{RES}}" : "\e[0m",  // reset
@@ -143,46 +191,196 @@ private void cache_256() {
  */
 public mapping query_colour_cache() { return copy(cache); }
 
+/**
+ * Checks whether the inside of a {{...}} is a tag we understand.
+ *
+ * @param {string} inner - The text between the braces
+ * @returns {int} 1 if it is a reset, attribute or hex colour tag
+ * @private
+ */
+private int valid_tag(string inner) {
+  int len = strlen(inner);
+
+  if(attributes["{{" + inner + "}}"])
+    return 1;
+
+  if(len != 3 && len != 6)
+    return 0;
+
+  foreach(int c in inner)
+    if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+      return 0;
+
+  return 1;
+}
+
+/**
+ * Compiles a tagged string into a span list in a single pass, or returns
+ * the cached one.
+ *
+ * The result alternates plain text and tags, starting and ending with
+ * text, so every odd index holds a full "{{...}}" tag.
+ *
+ * @param {string} text - The text to compile
+ * @returns {mixed*} The span list
+ * @private
+ */
+private mixed *compile_colour(string text) {
+  mixed *result = spans[text];
+  string *pieces, current;
+  int i, sz, close;
+
+  if(result) {
+    span_hits++;
+    return result;
+  }
+
+  span_misses++;
+
+  // Pad both ends so that no piece is lost to a leading or trailing
+  // delimiter, then take the padding back off.
+  pieces = explode("." + text + ".", "{{");
+  sz = sizeof(pieces);
+  pieces[0] = pieces[0][1..<1];
+  pieces[sz - 1] = pieces[sz - 1][0..<2];
+
+  result = ({ });
+  current = pieces[0];
+
+  for(i = 1; i < sz; i++) {
+    string piece = pieces[i];
+
+    close = strsrch(piece[0..TAG_MAX_INNER + 1], "}}");
+    if(close > 0 && valid_tag(piece[0..close - 1])) {
+      result += ({ current, "{{" + piece[0..close - 1] + "}}" });
+      current = piece[close + 2..<1];
+      continue;
+    }
+
+    // "{{{FFF}}" is a stray brace followed by a tag.
+    if(piece[0..0] == "{") {
+      close = strsrch(piece[1..TAG_MAX_INNER + 2], "}}");
+      if(close > 0 && valid_tag(piece[1..close])) {
+        result += ({ current + "{", "{{" + piece[1..close] + "}}" });
+        current = piece[close + 3..<1];
+        continue;
+      }
+    }
+
+    current += "{{" + piece;
+  }
+
+  result += ({ current });
+
+  if(strlen(text) <= SPAN_CACHE_MAX_LENGTH) {
+    if(sizeof(spans) >= SPAN_CACHE_MAX)
+      spans = ([ ]);
+
+    spans[text] = result;
+  }
+
+  return result;
+}
+
 /**
  * Substitutes colour codes in text according to the specified mode.
  *
  * @param {string} text - The text containing colour codes
- * @param {string} mode - The mode to use ("on" or "off")
+ * @param {string} mode - "on" or "truecolour", "256", "16", or anything
+ *                        else to strip the codes
  * @returns {string} Text with colour codes processed according to mode
  */
 public string substitute_colour(string text, string mode) {
   mixed *parts;
-  string *tags;
-  int *matches;
-  int sz;
+  int emit, sz, i;
+
+  if(!stringp(text) || strsrch(text, "{{") == -1)
+    return text;
 
-  parts = pcre_assoc(text, ({COLOUR_REGEX}), ({ 1 }), 0);
-  tags = parts[0];
-  matches = parts[1];
-  sz = sizeof(matches);
+  parts = compile_colour(text);
+  sz = sizeof(parts);
 
-  if(mode == "on") {
-    while(sz--) {
-      string good;
+  if(sz == 1)
+    return text;
 
-      if(!matches[sz])
-        continue;
+  emit = modes[mode];
+  parts = copy(parts);
 
-      if(good = cached(tags[sz])) {
-        tags[sz] = good;
-      } else {
-        string sequence = hex_to_sequence(tags[sz]);
+  for(i = 1; i < sz; i += 2)
+    parts[i] = emit == EMIT_OFF ? "" : tag_sequence(parts[i], emit);
 
-        cache[tags[sz]] = sequence;
-        tags[sz] = sequence;
-      }
+  return implode(parts, "");
+}
+
+/**
+ * Returns the escape sequence for a tag in the given mode.
+ *
+ * @param {string} tag - The full "{{...}}" tag
+ * @param {int} mode - One of the EMIT_ modes other than EMIT_OFF
+ * @returns {string} The escape sequence
+ * @private
+ */
+private string tag_sequence(string tag, int mode) {
+  mapping lookup;
+  string sequence;
+  int *rgb;
+
+  if(mode == EMIT_TRUECOLOUR || attributes[tag])
+    return cached(tag);
+
+  lookup = mode_cache[mode];
+  if(sequence = lookup[tag])
+    return sequence;
+
+  rgb = hex_to_rgb(tag);
+
+  if(mode == EMIT_256)
+    sequence = sprintf("\e[38;5;%dm", rgb_to_colour(rgb[0], rgb[1], rgb[2]));
+  else {
+    int code = nearest_ansi16(rgb);
+
+    sequence = sprintf("\e[%dm", code < 8 ? 30 + code : 90 + code - 8);
+  }
+
+  return lookup[tag] = sequence;
+}
+
+/**
+ * Finds the closest of the 16 base ANSI colours to an RGB value.
+ *
+ * @param {int*} rgb - The colour
+ * @returns {int} The base colour index, 0-15
+ * @private
+ */
+private int nearest_ansi16(int *rgb) {
+  int best, best_distance = -1;
+
+  for(int i = 0; i < 16; i++) {
+    int *base = ansi_rgb[i];
+    int dr = rgb[0] - base[0], dg = rgb[1] - base[1], db = rgb[2] - base[2];
+    int distance = dr * dr + dg * dg + db * db;
+
+    if(best_distance == -1 || distance < best_distance) {
+      best = i;
+      best_distance = distance;
     }
-  } else {
-    while(sz--)
-      tags[sz] = matches[sz] ? "" : tags[sz];
   }
 
-  return implode(tags, "");
+  return best;
+}
+
+/**
+ * Returns statistics about the span cache, for diagnostics.
+ *
+ * @returns {mapping} Cache size and hit counts
+ */
+public mapping query_span_stats() {
+  return ([
+    "size"     : sizeof(spans),
+    "capacity" : SPAN_CACHE_MAX,
+    "hits"     : span_hits,
+    "misses"   : span_misses,
+  ]);
 }
 
 /**
@@ -247,7 +445,10 @@ public string wrap(string str, int wrap_at, int indent_at) {
  * @returns {int} 1 if colour codes are present, 0 otherwise
  */
 int colourp(string text) {
-  return pcre_match(text, COLOUR_REGEX);
+  if(!stringp(text) || strsrch(text, "{{") == -1)
+    return 0;
+
+  return sizeof(compile_colour(text)) > 1;
 }
 
 private nosave int *colours = ({
@@ -535,10 +736,14 @@ public int rgb_to_colour(int r, int g, int b) {
   if(r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255)
     error("Invalid RGB values: " + r + ", " + g + ", " + b);
 
-  if(r == g && g == b)
-    // Grayscale
-    return (r - 8) / 10 + 232; // 232-255 maps to 8-255
-  else if(r >= 0 && r < 128 && g >= 0 && g < 128 && b >= 0 && b < 128)
+  if(r == g && g == b) {
+    // Grayscale. The ramp runs from 8 to 238; anything nearer white than
+    // that is the cube's white.
+    if(r > 246)
+      return 231;
+
+    return (r - 8) / 10 + 232; // 232-255 maps to 8-238
+  } else if(r >= 0 && r < 128 && g >= 0 && g < 128 && b >= 0 && b < 128)
     // Standard 16 colours
     return (r > 0 ? 1 : 0) + (g > 0 ? 2 : 0) + (b > 0 ? 4 : 0);
   else {
@@ -637,6 +842,8 @@ string hex_to_sequence(string hex, int mode) {
  * @returns {void}
  */
 void resync() {
+  spans = ([ ]);
+  mode_cache = ([ EMIT_16 : ([ ]), EMIT_256 : ([ ]) ]);
   cache_attributes();
   cache_256();
 }
@@ -0,0 +1,195 @@
+/**
+ * @file /adm/daemons/command.c
+ * @description Command resolution daemon. Keeps an index of the verbs found
+ *              in each command directory and resolves a verb against a
+ *              command path without touching the filesystem.
+ *
+ * Resolutions are cached per distinct path list, including misses, so a
+ * mistyped verb or an emote only costs a mapping lookup. A directory's index
+ * is rebuilt when its modification time changes, and every resolution that
+ * depended on it is dropped at the same time.
+ *
+ * @created 2026-10-17 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
+ *
+ * @history
+ * 2026-10-17 - Gesslar - Created
+ */
+
+inherit STD_DAEMON;
+
+// Forward declarations
+public string *resolve_command(string *path, string verb);
+public void rehash(string dir);
+public void rehash_all();
+private mapping index_directory(string dir);
+private int directory_mtime(string dir);
+
+// Upper bound on cached verbs per path list before it is flushed
+#define MAX_RESOLVED 1024
+// Upper bound on distinct path lists before the whole cache is flushed
+#define MAX_PATHS 64
+
+/**
+ * dir -> ([ "mtime" : int, "verbs" : ([ verb : 1 ]) ])
+ */
+private nosave mapping _dirs = ([ ]);
+
+/**
+ * path key -> ([ verb : string* ]), an empty array being a cached miss
+ */
+private nosave mapping _resolved = ([ ]);
+
+void setup() {
+  set_no_clean(1);
+  set_heart_beat(10);
+}
+
+/**
+ * Resolves a verb against a command path, returning every command object
+ * that provides it, in path order.
+ *
+ * @param {string*} path - The command path, each entry ending in a slash
+ * @param {string} verb - The verb to resolve
+ * @returns {string*} The command files, without extension, or an empty array
+ */
+public string *resolve_command(string *path, string verb) {
+  string key;
+  mapping cache;
+  string *result;
+
+  if(!pointerp(path) || !sizeof(path) || !stringp(verb) || !strlen(verb))
+    return ({});
+
+  key = implode(path, ":");
+  cache = _resolved[key];
+
+  if(!mapp(cache)) {
+    if(sizeof(_resolved) >= MAX_PATHS)
+      _resolved = ([ ]);
+
+    cache = _resolved[key] = ([ ]);
+  } else if(!nullp(result = cache[verb]))
+    return result;
+
+  if(sizeof(cache) >= MAX_RESOLVED)
+    cache = _resolved[key] = ([ ]);
+
+  result = ({});
+  foreach(string dir in path) {
+    mapping info = _dirs[dir] || index_directory(dir);
+
+    if(info["verbs"][verb])
+      result += ({ dir + verb });
+  }
+
+  cache[verb] = result;
+
+  return result;
+}
+
+/**
+ * Drops and rebuilds the index for a single directory, along with every
+ * cached resolution.
+ *
+ * @param {string} dir - The directory to rehash
+ */
+public void rehash(string dir) {
+  if(!stringp(dir))
+    return;
+
+  dir = append(dir, "/");
+
+  map_delete(_dirs, dir);
+  _resolved = ([ ]);
+
+  if(directory_exists(dir))
+    index_directory(dir);
+}
+
+/**
+ * Drops every directory index and cached resolution.
+ */
+public void rehash_all() {
+  _dirs = ([ ]);
+  _resolved = ([ ]);
+}
+
+/**
+ * Builds the verb index for a directory.
+ *
+ * @param {string} dir - The directory to index
+ * @returns {mapping} The index entry for the directory
+ */
+private mapping index_directory(string dir) {
+  mapping verbs = ([ ]);
+  mixed *files = get_dir(dir + "*.c");
+
+  if(pointerp(files))
+    foreach(string file in files)
+      verbs[file[0..<3]] = 1;
+
+  return _dirs[dir] = ([
+    "mtime" : directory_mtime(dir),
+    "verbs" : verbs,
+  ]);
+}
+
+/**
+ * Returns the modification time of a directory.
+ *
+ * @param {string} dir - The directory, with a trailing slash
+ * @returns {int} The modification time, or 0 if it does not exist
+ */
+private int directory_mtime(string dir) {
+  mixed *info = get_dir(dir[0..<2], -1);
+
+  if(!pointerp(info) || !sizeof(info))
+    return 0;
+
+  return info[0][2];
+}
+
+/**
+ * Rehashes any indexed directory whose contents have changed since it was
+ * last scanned.
+ */
+void heart_beat() {
+  string *stale = ({});
+
+  foreach(string dir, mapping info in _dirs)
+    if(directory_mtime(dir) != info["mtime"])
+      stale += ({ dir });
+
+  if(!sizeof(stale))
+    return;
+
+  foreach(string dir in stale) {
+    map_delete(_dirs, dir);
+    if(directory_exists(dir))
+      index_directory(dir);
+  }
+
+  _resolved = ([ ]);
+}
+
+/**
+ * Returns statistics about the index, for diagnostics.
+ *
+ * @returns {mapping} Counts of indexed directories, path lists and verbs
+ */
+public mapping query_stats() {
+  int resolved = 0, misses = 0;
+
+  foreach(string key, mapping cache in _resolved) {
+    resolved += sizeof(cache);
+    misses += sizeof(filter(cache, (: !sizeof($2) :)));
+  }
+
+  return ([
+    "directories" : sizeof(_dirs),
+    "paths"       : sizeof(_resolved),
+    "resolved"    : resolved,
+    "misses"      : misses,
+  ]);
+}
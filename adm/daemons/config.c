@@ -12,11 +12,17 @@
  * - Easy upgrades without losing custom settings
  * - Environment-specific configurations
  *
+ * Each rehash produces a new merged mapping which is never modified once
+ * published. The mud_config() simul_efun keeps a reference to it and is told
+ * to drop that reference by SIG_SYS_CONFIG_CHANGED, so ordinary lookups never
+ * need to call into this daemon.
+ *
  * @created 2024-02-03 - Gesslar
- * @last_modified 2024-02-03 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-02-03 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Publish an immutable snapshot for mud_config()
  */
 
 inherit STD_DAEMON;
@@ -24,6 +30,7 @@ inherit STD_DAEMON;
 // Forward declarations
 public void rehash_config();
 public mixed get_mud_config(string key);
+public mapping get_config_snapshot();
 
 private nosave string DEFAULT_CONFIG = "/adm/etc/default.json";
 private nosave string CONFIG_FILE = "/adm/etc/config.json";
@@ -69,21 +76,41 @@ public mixed get_mud_config(string key) {
  * Later values override earlier ones for the same keys.
  */
 public void rehash_config() {
+    mapping merged = ([ ]);
     mapping temp;
 
     if(file_exists(DEFAULT_CONFIG)) {
         temp = json_decode(read_file(DEFAULT_CONFIG));
         if(mapp(temp)) {
-            config += temp;
+            merged += temp;
         }
     }
 
     if(file_exists(CONFIG_FILE)) {
         temp = json_decode(read_file(CONFIG_FILE));
         if(mapp(temp)) {
-            config += temp;
+            merged += temp;
         }
     }
+
+    // Swap in the new snapshot whole; the old one is left untouched for
+    // anyone still holding it.
+    config = merged;
+
+    // The signal daemon relies on configuration, so during boot it is not
+    // there to tell, and nobody has a snapshot to invalidate yet anyway.
+    if(find_object(SIGNAL_D))
+        emit(SIG_SYS_CONFIG_CHANGED);
+}
+
+/**
+ * Returns the current configuration snapshot. The mapping is shared and
+ * must not be modified; it is replaced, not changed, by rehash_config().
+ *
+ * @returns {mapping} The merged configuration
+ */
+public mapping get_config_snapshot() {
+    return config;
 }
 
 /**
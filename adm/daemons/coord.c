@@ -3,10 +3,11 @@
  * @description Coordinate daemon to hold room data
  *
  * @created 2024-08-18 - Gesslar
- * @last_modified 2024-08-18 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-08-18 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Generation counter for consumers caching coordinates
  */
 
 #include <classes.h>
@@ -17,6 +18,7 @@ inherit CLASS_ROOMINFO;
 
 private nomask mapping rooms = ([ ]);
 private nomask mixed *rooms_array = ({ });
+private nosave int generation = 1;
 
 void setup() {
   set_persistent(1);
@@ -25,6 +27,7 @@ void setup() {
 void set_coordinate_data(mapping m) {
   rooms = m;
   rooms_array = map(values(rooms), (: $1.coords :));
+  generation++;
 
   save_data();
 }
@@ -33,6 +36,12 @@ mapping get_coordinate_data() {
   return copy(rooms);
 }
 
+// Bumped whenever the coordinate data is replaced, so callers that cache
+// coordinates know to look them up again.
+int query_generation() {
+  return generation;
+}
+
 int *get_coordinates(string room) {
   if(classp(rooms[room]))
     return rooms[room].coords;
@@ -1,10 +1,16 @@
 // /adm/daemons/db.c
 // DB Daemon
 //
+// Connections are pooled per database and reused across queries. Lazy
+// queries page through their results with a keyset cursor rather than
+// LIMIT/OFFSET, and read as many chunks per execution as the eval budget
+// allows.
+//
 // Created:     2024/02/27: Gesslar
-// Last Change: 2024/02/27: Gesslar
+// Last Change: 2026/10/17: Gesslar
 //
 // 2024/02/27: Gesslar - Created
+// 2026/10/17: Gesslar - Connection pool, keyset paging and eval-cost pacing
 
 inherit STD_DAEMON;
 
@@ -21,21 +27,59 @@ int allow_upsert(string db);
 mixed sqlite_version(string db);
 string statement_from_mapping(mapping data);
 private mapping *collate_data(mixed *result);
-private void execute_query(string db, string q, int offset, string query_id, mixed *callback);
+private mixed fetch_rows(int fd, string db, string q, int rows);
+private int acquire_handle(string db);
+private void release_handle(string db, int fd);
+private void discard_handle(string db, int fd);
+private mixed *keyset_statements(string q, string key);
+private string sql_literal(mixed value);
+void execute_query(string query_id);
 mapping query_databases();
 mapping query_tables(string db_name);
-void lazy_query(string db, string q, mixed *callback);
-
+varargs string lazy_query(string db, string q, mixed *callback, string key);
+void close_all();
+mapping query_pool_stats();
+
+// Handles kept open per database
+#define POOL_MAX            4
+// Seconds an unused handle is kept before it is closed
+#define POOL_IDLE_TIMEOUT   300
+// Distinct lazy queries whose chunk statements are kept
+#define STATEMENT_CACHE_MAX 128
+// Portion of the eval limit a lazy query leaves untouched before it yields
+#define EVAL_RESERVE_DIVISOR 4
+
+// db -> ({ ({ fd, last_used }), ... }) of idle handles
+private nosave mapping pool = ([ ]);
+// db -> number of handles currently handed out
+private nosave mapping in_use = ([ ]);
+// "key\nquery" -> ({ first chunk statement, later chunk format })
+private nosave mapping statements = ([ ]);
+// query id -> lazy query state
 private nosave mapping handle = ([ ]);
 private nosave mapping databases = ([ ]);
 private nosave mapping table_definitions = ([ ]);
 private nosave int db_chunk_size = mud_config("DB_CHUNK_SIZE");
+private nosave mapping pool_stats = ([
+    "connects"   : 0,
+    "reuses"     : 0,
+    "closes"     : 0,
+    "discards"   : 0,
+    "chunks"     : 0,
+    "yields"     : 0,
+]);
 
 void setup() {
     string db_path = mud_config("DB_PATH");
     string db_suffix = mud_config("DB_SUFFIX");
     string table_suffix = mud_config("DB_TABLE_SUFFIX");
 
+    set_no_clean(1);
+    set_heart_beat(60);
+
+    slot(SIG_SYS_SHUTDOWN, "close_all");
+    slot(SIG_SYS_CRASH, "close_all");
+
     databases = ([ ]);
     table_definitions = ([ ]);
 
@@ -65,7 +109,6 @@ void setup() {
         // Now, create databases and tables based on the table definitions
         foreach(string db_name, mapping tables in table_definitions) {
             string database_file = db_path + db_name + db_suffix;
-            int con = -1;
 
             databases[db_name] = database_file;
 
@@ -73,30 +116,22 @@ void setup() {
                 mixed err = catch {
                     int fd;
                     mixed result;
-                    int close_result;
-                    string current;
 
-                    fd = db_connect("", database_file, "", __USE_SQLITE3__);
-                    if(fd == 0) {
-                        log_file("system/db", "Error connecting to " + db_name + " at " + database_file + "\n");
+                    fd = acquire_handle(db_name);
+                    if(fd == 0)
                         return;
-                    }
 
                     foreach(string table_name, string table_definition in tables) {
-                        current = table_name;
                         result = db_exec(fd, "CREATE TABLE IF NOT EXISTS " + table_name + " (" + table_definition + ")");
 
                         if(stringp(result)) {
                             log_file("system/db", "Error creating table " + table_name + " in " + db_name + ": " + result + "\n");
+                            discard_handle(db_name, fd);
                             return;
                         }
                     }
 
-                    close_result = db_close(fd);
-                    if(close_result == 0) {
-                        log_file("system/db", "Error closing connection to " + db_name + " at " + database_file + "\n");
-                        return;
-                    }
+                    release_handle(db_name, fd);
                 };
                 if(err) {
                     log_file("system/db", "Error creating tables in " + db_name + ": " + err + "\n");
@@ -107,6 +142,113 @@ void setup() {
     }
 }
 
+/**
+ * @function acquire_handle
+ * @description Hands out an open connection to a database, reusing an idle
+ *              one from the pool when there is one.
+ * @param {string} db - The name of the database.
+ * @returns {int} - The connection handle, or 0 on failure.
+ */
+private int acquire_handle(string db) {
+    string database_file = databases[db];
+    mixed *idle = pool[db];
+    int fd;
+
+    if(!database_file)
+        return 0;
+
+    if(sizeof(idle)) {
+        fd = idle[<1][0];
+        pool[db] = idle[0..<2];
+        in_use[db]++;
+        pool_stats["reuses"]++;
+        return fd;
+    }
+
+    fd = db_connect("", database_file, "", __USE_SQLITE3__);
+    if(fd == 0) {
+        log_file("system/db", "Error connecting to " + db + " at " + database_file + "\n");
+        return 0;
+    }
+
+    in_use[db]++;
+    pool_stats["connects"]++;
+
+    return fd;
+}
+
+/**
+ * @function release_handle
+ * @description Returns a connection to the pool, closing it instead if the
+ *              pool for that database is already full.
+ * @param {string} db - The name of the database.
+ * @param {int} fd - The connection handle.
+ */
+private void release_handle(string db, int fd) {
+    mixed *idle = pool[db] || ({ });
+
+    if(in_use[db] > 0)
+        in_use[db]--;
+
+    if(sizeof(idle) >= POOL_MAX) {
+        if(db_close(fd) == 0)
+            log_file("system/db", "Error closing connection to " + db + " at " + databases[db] + "\n");
+        pool_stats["closes"]++;
+        return;
+    }
+
+    pool[db] = idle + ({ ({ fd, time() }) });
+}
+
+/**
+ * @function discard_handle
+ * @description Closes a connection that has reported an error rather than
+ *              returning it to the pool.
+ * @param {string} db - The name of the database.
+ * @param {int} fd - The connection handle.
+ */
+private void discard_handle(string db, int fd) {
+    if(in_use[db] > 0)
+        in_use[db]--;
+
+    catch(db_close(fd));
+    pool_stats["discards"]++;
+}
+
+/**
+ * @daemon_function close_all
+ * @description Closes every idle pooled connection.
+ */
+void close_all() {
+    foreach(string db, mixed *idle in pool) {
+        foreach(mixed *entry in idle) {
+            catch(db_close(entry[0]));
+            pool_stats["closes"]++;
+        }
+    }
+
+    pool = ([ ]);
+}
+
+/**
+ * @daemon_function query_pool_stats
+ * @description Reports the state of the connection pool and lazy queries.
+ * @returns {mapping} - Pool and paging counters.
+ */
+mapping query_pool_stats() {
+    mapping idle = ([ ]);
+
+    foreach(string db, mixed *entries in pool)
+        idle[db] = sizeof(entries);
+
+    return pool_stats + ([
+        "idle"       : idle,
+        "in_use"     : copy(in_use),
+        "statements" : sizeof(statements),
+        "pending"    : sizeof(handle),
+    ]);
+}
+
 /**
  * @function collate_data
  * @description Collates query result data into a more usable format.
@@ -131,6 +273,34 @@ private mapping *collate_data(mixed *result) {
     return data;
 }
 
+/**
+ * @function fetch_rows
+ * @description Fetches the header and every row of the last result on a
+ *              connection.
+ * @param {int} fd - The connection handle.
+ * @param {string} db - The name of the database, for logging.
+ * @param {string} q - The SQL that was run, for logging.
+ * @param {int} rows - The row count returned by db_exec.
+ * @returns {mixed[]} - The raw result, header first.
+ */
+private mixed fetch_rows(int fd, string db, string q, int rows) {
+    mixed *result = allocate(rows+1);
+    int i;
+
+    catch {
+        for(i = 0; i <= rows; i++) {
+            mixed info = db_fetch(fd, i);
+
+            if(stringp(info))
+                log_file("system/db", "Error fetching row " + i + " in " + db + ": '" + q + "' " + info + "\n");
+            else
+                result[i] = info;
+        }
+    };
+
+    return result;
+}
+
 /**
  * @daemon_function query
  * @description Executes a SQL query on the specified database.
@@ -140,49 +310,33 @@ private mapping *collate_data(mixed *result) {
  * @returns {mixed} - Query result or 1 if callback is provided.
  */
 mixed query(string db, string q, mixed *callback) {
-    string database_file = databases[db];
     int fd;
-    int close_result, i;
     mixed rows, *result = ({ });
 
     if(!db || !q)
         return "Invalid db or query.";
 
     q = append(q, ";");
-    fd = db_connect("", database_file, "", __USE_SQLITE3__);
-    if(fd == 0) {
-        log_file("system/db", "Error connecting to " + db + " at " + database_file + "\n");
+    fd = acquire_handle(db);
+    if(fd == 0)
         return 0;
-    }
 
     rows = db_exec(fd, q);
 
     if(stringp(rows)) {
+        discard_handle(db, fd);
         log_file("system/db", "Error querying " + db + ": " + rows + "\n");
         return "Error querying " + db + ": " + rows + "\n";
     }
 
-    if(rows == 0)
+    if(rows == 0) {
+        release_handle(db, fd);
         return 0;
-
-    result = allocate(rows+1);
-    catch {
-        for(i = 0; i <= rows; i++) {
-            mixed info = db_fetch(fd, i);
-
-            if(stringp(info))
-                log_file("system/db", "Error fetching row " + i + " in " + db + ": '" + q + "' " + info + "\n");
-            else
-                result[i] = info;
-        }
-    };
-
-    close_result = db_close(fd);
-    if(close_result == 0) {
-        log_file("system/db", "Error closing connection to " + db + " at " + database_file + "\n");
-        return "Error closing connection to " + db + " at " + database_file + "\n";
     }
 
+    result = fetch_rows(fd, db, q, rows);
+    release_handle(db, fd);
+
     if(callback) {
         call_back(callback, collate_data(result));
         return 1;
@@ -193,91 +347,178 @@ mixed query(string db, string q, mixed *callback) {
 
 /**
  * @daemon_function lazy_query
- * @description Initiates a lazy (chunked) query execution.
+ * @description Initiates a lazy (chunked) query execution. Chunks are read
+ *              with a keyset cursor on the given column, so the query must
+ *              select that column, and it must be unique and orderable.
+ *              The callback receives every row, collated as with query().
  * @param {string} db - The name of the database to query.
  * @param {string} q - The SQL query to execute.
  * @param {mixed[]} callback - Callback function to handle the result.
+ * @param {string} [key] - The cursor column, "id" by default.
+ * @returns {string} - The id of the lazy query.
  */
-void lazy_query(string db, string q, mixed *callback) {
+varargs string lazy_query(string db, string q, mixed *callback, string key) {
     string query_id = db + "_" + time_ns();
-    execute_query(db, q, 0, query_id, callback);
+
+    handle[query_id] = ([
+        "db"       : db,
+        "key"      : key || "id",
+        "query"    : q,
+        "cursor"   : null,
+        "rows"     : ({ }),
+        "callback" : callback,
+    ]);
+
+    execute_query(query_id);
+
+    return query_id;
+}
+
+/**
+ * @function keyset_statements
+ * @description Builds, or returns from cache, the statements used to page
+ *              through a query by key.
+ * @param {string} q - The SQL query.
+ * @param {string} key - The cursor column.
+ * @returns {mixed[]} - The first chunk's statement and the sprintf format for
+ *                      each chunk after it.
+ */
+private mixed *keyset_statements(string q, string key) {
+    string cache_key = key + "\n" + q;
+    mixed *result = statements[cache_key];
+    string inner, tail;
+
+    if(result)
+        return result;
+
+    if(sizeof(statements) >= STATEMENT_CACHE_MAX)
+        statements = ([ ]);
+
+    inner = trim(q);
+    while(strlen(inner) && inner[<1] == ';')
+        inner = trim(inner[0..<2]);
+
+    tail = " ORDER BY " + key + " LIMIT " + db_chunk_size + ";";
+
+    result = ({
+        "SELECT * FROM (" + inner + ")" + tail,
+        "SELECT * FROM (" + replace_string(inner, "%", "%%") + ") WHERE " + key + " > %s" + replace_string(tail, "%", "%%"),
+    });
+
+    return statements[cache_key] = result;
+}
+
+/**
+ * @function sql_literal
+ * @description Renders a value as a SQL literal.
+ * @param {mixed} value - The value.
+ * @returns {string} - The literal.
+ */
+private string sql_literal(mixed value) {
+    if(stringp(value))
+        return "'" + replace_string(value, "'", "''") + "'";
+
+    if(nullp(value))
+        return "NULL";
+
+    return (string)value;
 }
 
 /**
  * @function execute_query
- * @description Executes a query in chunks, handling large result sets efficiently.
- * @param {string} db - The name of the database to query.
- * @param {string} q - The SQL query to execute.
- * @param {int} offset - The current offset for chunked queries.
- * @param {string} query_id - A unique identifier for this query execution.
- * @param {mixed[]} callback - Callback function to handle the result.
+ * @description Reads a lazy query's chunks, continuing until the result is
+ *              exhausted or the eval budget for this execution runs low, in
+ *              which case it picks up again on the next backend cycle.
+ * @param {string} query_id - The id of the lazy query.
  */
-private void execute_query(string db, string q, int offset, string query_id, mixed *callback) {
-    string database_file, modified_query;
-    int fd, close_result, i;
-    mixed rows, *result;
+void execute_query(string query_id) {
+    mapping state = handle[query_id];
+    int reserve = max_eval_cost() / EVAL_RESERVE_DIVISOR;
+    string db, q;
+    mixed *stmts, *callback;
+    int fd;
 
-    database_file = databases[db];
-    result = ({ });
+    if(!state)
+        return;
 
-    // Modify the query to include LIMIT and OFFSET
-    modified_query = q + " LIMIT " + db_chunk_size + " OFFSET " + offset;
+    db = state["db"];
+    callback = state["callback"];
+    stmts = keyset_statements(state["query"], state["key"]);
 
-    fd = db_connect("", database_file, "", __USE_SQLITE3__);
+    fd = acquire_handle(db);
     if(fd == 0) {
-        log_file("system/db", "Error connecting to " + db + " at " + database_file + "\n");
         if(callback) call_back(callback, "Error: Connection failed.");
         map_delete(handle, query_id);
         return;
     }
 
-    rows = db_exec(fd, modified_query);
+    while(1) {
+        mixed rows;
+        mapping *chunk;
 
-    if(stringp(rows)) {
-        log_file("system/db", "Error querying " + db + ": " + rows + "\n");
-        if(callback) call_back(callback, "Error: Query failed - " + rows);
-        map_delete(handle, query_id);
-        return;
-    }
+        if(nullp(state["cursor"]))
+            q = stmts[0];
+        else
+            q = sprintf(stmts[1], sql_literal(state["cursor"]));
 
-    if(rows == 0) {
-        // If no more rows, finalize the result and invoke the callback
-        if(callback) call_back(callback, handle[query_id]);
-        map_delete(handle, query_id);
-        return;
-    }
+        rows = db_exec(fd, q);
+        pool_stats["chunks"]++;
 
-    result = allocate(rows+1);
-    for(i = 0; i <= rows; i++) {
-        mixed info = db_fetch(fd, i);
-        if(stringp(info)) {
-            log_file("system/db", "Error fetching row " + i + " in " + db + ": '" + q + "' " + info + "\n");
-        } else {
-            result[i] = info;
+        if(stringp(rows)) {
+            discard_handle(db, fd);
+            log_file("system/db", "Error querying " + db + ": " + rows + "\n");
+            if(callback) call_back(callback, "Error: Query failed - " + rows);
+            map_delete(handle, query_id);
+            return;
         }
-    }
 
-    // Accumulate the results for this chunk
-    if(!arrayp(handle[query_id])) {
-        handle[query_id] = ({ });
-    }
-    handle[query_id] += result ; // Append the results from this chunk
+        chunk = rows ? collate_data(fetch_rows(fd, db, q, rows)) : ({ });
+        state["rows"] += chunk;
 
-    close_result = db_close(fd);
-    if(close_result == 0) {
-        log_file("system/db", "Error closing connection to " + db + " at " + database_file + "\n");
-        if(callback) call_back(callback, "Error: Connection close failed.");
-        map_delete(handle, query_id);
-        return;
+        // A short chunk means there is nothing after it.
+        if(rows < db_chunk_size)
+            break;
+
+        state["cursor"] = chunk[<1][state["key"]];
+        if(nullp(state["cursor"])) {
+            log_file("system/db", "Lazy query on " + db + " did not select its key column '" + state["key"] + "': " + state["query"] + "\n");
+            break;
+        }
+
+        if(eval_cost() < reserve) {
+            release_handle(db, fd);
+            pool_stats["yields"]++;
+            call_out("execute_query", 0, query_id);
+            return;
+        }
     }
 
-    // If the chunk returned exactly db_chunk_size rows, there might be more data to fetch
-    if(sizeof(rows) == db_chunk_size) {
-        call_out("execute_query", 1, db, q, offset + db_chunk_size, query_id, callback);
-    } else {
-        // Final chunk, process the accumulated result
-        if(callback) call_back(callback, handle[query_id]);
-        map_delete(handle, query_id);
+    release_handle(db, fd);
+
+    if(callback) call_back(callback, state["rows"]);
+    map_delete(handle, query_id);
+}
+
+/**
+ * Closes pooled handles that have sat idle for longer than the timeout.
+ */
+void heart_beat() {
+    int cutoff = time() - POOL_IDLE_TIMEOUT;
+
+    foreach(string db, mixed *idle in pool) {
+        mixed *keep = ({ });
+
+        foreach(mixed *entry in idle) {
+            if(entry[1] >= cutoff) {
+                keep += ({ entry });
+                continue;
+            }
+
+            catch(db_close(entry[0]));
+            pool_stats["closes"]++;
+        }
+
+        pool[db] = keep;
     }
 }
 
@@ -21,16 +21,29 @@ string *parse(string str);
 void add_alias(string verb, string cm, string *groups);
 mapping get_alias(string priv);
 mapping get_xverb(string priv);
+mixed *get_snapshot(string priv);
+int query_generation();
+void invalidate();
 
 /* Global Variables */
 
 mapping xverb = ([]);
 mapping alias = ([]);
 
+/* Merged aliases and xverbs per privilege, and a counter that is bumped
+   whenever they may have changed so bodies know to rebuild their own. It
+   starts from the load time, so a reloaded server never repeats a
+   generation a body has already cached. */
+private nosave mapping snapshots = ([]);
+private nosave int generation = time_ns();
+private nosave string groups_signature;
+
 /* Functions */
 
 int setup() {
      set_no_clean(1);
+     set_heart_beat(60);
+     groups_signature = save_variable(master()->query_groups());
      parse_config();
 }
 
@@ -44,6 +57,10 @@ void parse_config() {
      time = time_frac();
      conf = parse(read_file(CONFIG_FILE));
 
+     xverb = ([]);
+     alias = ([]);
+     invalidate();
+
      for(i = 0; i < sizeof(conf); i++) {
           string groups, verb, alias;
 
@@ -121,24 +138,48 @@ void add_alias(string verb, string cmd, string *groups) {
      }
 }
 
-mapping get_alias(string priv) {
-     int i;
-     string *keys = keys(alias);
-     mapping ret = ([]);
+/* Returns ({ aliases, xverbs }) as they apply to priv, merged once and then
+   served from the cache until the config or the groups change. Callers must
+   not modify the mappings. */
+mixed *get_snapshot(string priv) {
+     mixed *snapshot = snapshots[priv];
+     mapping a = ([]), x = ([]);
 
-     for(i = 0; i < sizeof(keys); i++)
-          if(is_member(priv, keys[i]) || keys[i] == "all") ret += alias[keys[i]];
+     if(snapshot) return snapshot;
+
+     foreach(string group, mapping entries in alias)
+          if(group == "all" || is_member(priv, group)) a += entries;
+
+     foreach(string group, mapping entries in xverb)
+          if(group == "all" || is_member(priv, group)) x += entries;
+
+     return snapshots[priv] = ({ a, x });
+}
 
-     return ret;
+mapping get_alias(string priv) {
+     return get_snapshot(priv)[0] + ([]);
 }
 
 mapping get_xverb(string priv) {
-     int i;
-     string *keys = keys(xverb);
-     mapping ret = ([]);
+     return get_snapshot(priv)[1] + ([]);
+}
+
+int query_generation() {
+     return generation;
+}
+
+void invalidate() {
+     snapshots = ([]);
+     generation++;
+}
+
+/* Group membership lives in the master object, so check now and then
+   whether it has changed under us. */
+void heart_beat() {
+     string signature = save_variable(master()->query_groups());
 
-     for(i = 0; i < sizeof(keys); i++)
-          if(is_member(priv, keys[i]) || keys[i] == "all") ret += xverb[keys[i]];
+     if(signature == groups_signature) return;
 
-     return ret;
+     groups_signature = signature;
+     invalidate();
 }
@@ -4,11 +4,17 @@
  * GMCP (Generic Mud Communication Protocol) daemon responsible for handling
  * all GMCP-related communications between the MUD and clients.
  *
+ * Packages are resolved to their handler module through a dispatch table,
+ * so a send does not parse the package name or touch the filesystem. A
+ * broadcast encodes each payload once and shares the bytes among everyone
+ * it reaches.
+ *
  * @created 2024-02-22 - Gesslar
- * @last_modified 2024-02-22 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-02-22 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Dispatch table and shared payload encoding
  */
 
 #include <classes.h>
@@ -21,6 +27,29 @@ class ClassGMCP convert_message(string message);
 varargs void send_gmcp(object body, string gmcp_package, mixed arg);
 varargs void broadcast_gmcp(mixed audience, string gmcp_package, mixed arg);
 void init_gmcp(object who);
+mixed stringify_payload(mixed data);
+string encode_payload(mixed data);
+void invalidate_dispatch();
+private mixed *resolve_package(string gmcp_package);
+private object module_object(string file);
+
+#define GMCP_MODULE_DIR __DIR__ "modules/gmcp/"
+
+// Dispatch entry layout
+#define DISPATCH_FILE      0
+#define DISPATCH_FUNCTION  1
+#define DISPATCH_SUBMODULE 2
+
+private nosave int gmcp_enabled;
+// Packages that have a handler module, e.g. ([ "Char" : 1 ])
+private nosave mapping handlers = ([ ]);
+// "Package.Module.Sub" -> ({ file, function, submodule }), or 0 if unhandled
+private nosave mapping dispatch = ([ ]);
+// file -> loaded module object
+private nosave mapping modules = ([ ]);
+// During a broadcast, payload -> encoded JSON
+private nosave mapping encoded = ([ ]);
+private nosave int broadcast_depth = 0;
 
 /**
  * Converts a GMCP message string into a structured ClassGMCP object.
@@ -87,34 +116,97 @@ class ClassGMCP convert_message(string message) {
   return gmcp;
 }
 
+/**
+ * Looks up the handler for a package, parsing it the first time it is
+ * seen.
+ *
+ * @param {string} gmcp_package - The GMCP package identifier
+ * @returns {mixed*} The dispatch entry, or 0 if nothing handles it
+ */
+private mixed *resolve_package(string gmcp_package) {
+  class ClassGMCP gmcp;
+  mixed *entry;
+
+  // Packages nothing handles are remembered as ({ }), so they are only
+  // parsed and logged once.
+  if(entry = dispatch[gmcp_package])
+    return sizeof(entry) ? entry : 0;
+
+  gmcp = convert_message(gmcp_package);
+  if(gmcp == null || (gmcp.package == null && gmcp.module == null)) {
+    dispatch[gmcp_package] = ({ });
+    return 0;
+  }
+
+  if(!handlers[gmcp.package]) {
+    log_file("system/gmcp", "[%s] Module %s not found [%O]",
+      ctime(),
+      GMCP_MODULE_DIR + gmcp.package + ".c",
+      previous_object(1) || previous_object()
+    );
+    dispatch[gmcp_package] = ({ });
+    return 0;
+  }
+
+  return dispatch[gmcp_package] = ({
+    GMCP_MODULE_DIR + gmcp.package,
+    gmcp.module,
+    gmcp.submodule,
+  });
+}
+
+/**
+ * Returns the loaded handler module, loading it again if it has been
+ * updated or destructed since it was last used.
+ *
+ * @param {string} file - The module file
+ * @returns {object} The module, or 0 if it failed to load
+ */
+private object module_object(string file) {
+  object ob = modules[file];
+
+  if(ob)
+    return ob;
+
+  if(catch(ob = load_object(file)))
+    return 0;
+
+  return modules[file] = ob;
+}
+
+/**
+ * Rescans the handler modules and drops every resolved package.
+ */
+void invalidate_dispatch() {
+  string *files = get_dir(GMCP_MODULE_DIR + "*.c") || ({ });
+
+  handlers = allocate_mapping(map(files, (: $1[0..<3] :)), 1);
+  dispatch = ([ ]);
+  modules = ([ ]);
+}
+
 /**
  * Sends a GMCP message to a specific player or object.
  *
  * This function handles the actual sending of GMCP messages to individual targets.
- * It validates the target, checks GMCP support, loads the appropriate module,
+ * It validates the target, checks GMCP support, looks up the appropriate module,
  * and dispatches the message.
  *
  * @param {object} body - The target object to receive the GMCP message
  * @param {string} gmcp_package - The GMCP package identifier
  * @param {mixed} [arg] - Optional payload data for the GMCP message
- * @errors If the GMCP module cannot be found or loaded
  */
 varargs void send_gmcp(object body, string gmcp_package, mixed arg) {
-  mixed *packet;
-  class ClassGMCP gmcp;
-  string gmcp_module;
-  mixed err;
+  mixed *entry;
   object ob;
-  string base;
 
-  if(!get_config(__RC_ENABLE_GMCP__))
+  if(!gmcp_enabled)
     return;
 
   if(!body || !gmcp_package)
     return;
 
-  base = base_name(body);
-  if(base == LOGIN_OB) {
+  if(base_name(body) == LOGIN_OB) {
     if(!has_gmcp(body))
       return;
   } else if(userp(body) || ghostp(body)) {
@@ -123,39 +215,24 @@ varargs void send_gmcp(object body, string gmcp_package, mixed arg) {
   } else
     return;
 
-  gmcp = convert_message(gmcp_package);
-  if(gmcp == null || (gmcp.package == null && gmcp.module == null))
+  if(!(entry = resolve_package(gmcp_package)))
     return;
 
-  gmcp.payload = arg;
-
-  gmcp_module = __DIR__ "modules/gmcp/" + gmcp.package + ".c";
-
-  if(!file_exists(gmcp_module)) {
-    log_file("system/gmcp", "[%s] Module %s not found [%O]",
-      ctime(),
-      gmcp_module,
-      previous_object()->query_gmcp_module() ?
-        previous_object(1) :
-        previous_object()
-    );
+  if(!(ob = module_object(entry[DISPATCH_FILE])))
     return;
-  }
 
-  if(err = catch(ob = load_object(gmcp_module)))
-    return;
-
-  if(gmcp.submodule)
-    call_other(gmcp_module, gmcp.module, body, gmcp.submodule, gmcp.payload);
+  if(entry[DISPATCH_SUBMODULE])
+    call_other(ob, entry[DISPATCH_FUNCTION], body, entry[DISPATCH_SUBMODULE], arg);
   else
-    call_other(gmcp_module, gmcp.module, body, gmcp.payload);
+    call_other(ob, entry[DISPATCH_FUNCTION], body, arg);
 }
 
 /**
  * Broadcasts a GMCP message to multiple recipients.
  *
  * This function handles broadcasting GMCP messages to either a single target,
- * all players in a room, or an array of targets.
+ * all players in a room, or an array of targets. A payload is only encoded
+ * once for the whole broadcast.
  *
  * @param {object|object*} audience - Target(s) to receive the message. Can be:
  *   - A room object (broadcasts to all players in the room)
@@ -166,8 +243,9 @@ varargs void send_gmcp(object body, string gmcp_package, mixed arg) {
  */
 varargs void broadcast_gmcp(mixed audience, string gmcp_package, mixed arg) {
   object *targets = ({ });
+  string e;
 
-  if(!get_config(__RC_ENABLE_GMCP__) || !gmcp_package || nullp(audience))
+  if(!gmcp_enabled || !gmcp_package || nullp(audience))
     return;
 
   if(objectp(audience)) {
@@ -181,8 +259,69 @@ varargs void broadcast_gmcp(mixed audience, string gmcp_package, mixed arg) {
     targets += audience;
   else
     return;
-  foreach(object target in targets)
-    send_gmcp(target, gmcp_package, arg);
+
+  broadcast_depth++;
+  e = catch {
+    foreach(object target in targets)
+      send_gmcp(target, gmcp_package, arg);
+  };
+
+  if(!--broadcast_depth)
+    encoded = ([ ]);
+
+  if(e)
+    error(e);
+}
+
+/**
+ * Sanitises data to be sent to the client. GMCP should always send keys
+ * and values as strings, so scalars are converted and anything that cannot
+ * be represented becomes an empty string.
+ *
+ * @param {mixed} data - The data to sanitise
+ * @returns {mixed} The sanitised data
+ */
+mixed stringify_payload(mixed data) {
+  switch(typeof(data)) {
+    case T_STRING:
+      return data;
+    case T_INT:
+      return sprintf("%d", data);
+    case T_ARRAY:
+      return map(data, (: stringify_payload :));
+    case T_MAPPING: {
+        mapping result = ([ ]);
+
+        foreach(mixed key, mixed value in data)
+          result[stringify_payload(key)] = stringify_payload(value);
+
+        return result;
+      }
+    case T_FLOAT:
+      return sprintf("%f", data);
+    default:
+      return "";
+  }
+}
+
+/**
+ * Encodes a payload as JSON. During a broadcast the result is kept, keyed
+ * on the payload itself, so every recipient handed the same payload shares
+ * one encoding.
+ *
+ * @param {mixed} data - The payload
+ * @returns {string} The encoded payload
+ */
+string encode_payload(mixed data) {
+  string result;
+
+  if(!broadcast_depth || (!mapp(data) && !pointerp(data)))
+    return json_encode(stringify_payload(data));
+
+  if(result = encoded[data])
+    return result;
+
+  return encoded[data] = json_encode(stringify_payload(data));
 }
 
 /**
@@ -194,6 +333,9 @@ varargs void broadcast_gmcp(mixed audience, string gmcp_package, mixed arg) {
  * @param {object} who - The player object to initialize GMCP for
  */
 void init_gmcp(object who) {
+  // The client is starting from nothing, so everything must be sent in full.
+  who->clear_gmcp_sent();
+
   send_gmcp(who, GMCP_PKG_CHAR_STATUSVARS);
   send_gmcp(who, GMCP_PKG_CHAR_STATUS);
   send_gmcp(who, GMCP_PKG_CHAR_VITALS);
@@ -203,8 +345,12 @@ void init_gmcp(object who) {
 }
 
 /**
- * Configures the daemon to prevent automatic cleanup.
+ * Configures the daemon to prevent automatic cleanup and builds the
+ * dispatch table.
  */
 void setup() {
   set_no_clean(1);
+
+  gmcp_enabled = get_config(__RC_ENABLE_GMCP__);
+  invalidate_dispatch();
 }
@@ -9,16 +9,23 @@
  * It is somewhat reminiscent of LP Terminal mappings, inasmuch as it's kind
  * of exactly the same thing.
  *
+ * Messages are transcoded in a single pass: one pattern matching every
+ * known glyph splits the message, and the glyphs are looked up in the
+ * table for the client's encoding. A message with no glyphs in it is
+ * returned as it is after a single scan.
+ *
  * @created 2024-07-13 - Gesslar
- * @last_modified 2024-07-13 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-07-13 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Single-pass table-driven transcoder
  */
 
 inherit STD_DAEMON;
 
 private nosave mapping line_drawing = ([ ]);
+private nosave string glyph_pattern;
 
 void setup() {
     line_drawing["UTF-8"] = ([
@@ -123,20 +130,41 @@ void setup() {
     ]);
 
     line_drawing["screenreader"] = allocate_mapping(keys(line_drawing["UTF-8"]), " ");
+
+    // None of the glyphs are regex metacharacters, so a plain alternation
+    // matches any of them.
+    glyph_pattern = implode(keys(line_drawing["UTF-8"]), "|");
 }
 
 private string replace_lines_characters(string mess, mapping replacement) {
-    string k, v;
+    mixed *parts;
+    string *pieces;
+    int *matches;
+    int sz;
+
+    if(!pcre_match(mess, glyph_pattern))
+        return mess;
+
+    parts = pcre_assoc(mess, ({ glyph_pattern }), ({ 1 }), 0);
+    pieces = parts[0];
+    matches = parts[1];
+    sz = sizeof(matches);
+
+    while(sz--) {
+        string glyph;
+
+        if(!matches[sz])
+            continue;
 
-    foreach(k, v in replacement) {
-        while(strsrch(mess, k) > -1) mess = replace_string(mess, k, v);
+        if(glyph = replacement[pieces[sz]])
+            pieces[sz] = glyph;
     }
 
-    return mess;
+    return implode(pieces, "");
 }
 
 string substitute_lines(string mess, string encoding) {
-    if(encoding == "UTF-8") return mess;
+    if(encoding == "UTF-8" || !stringp(mess) || mess == "") return mess;
     if(of(encoding, line_drawing)) return replace_lines_characters(mess, line_drawing[encoding]);
     return replace_lines_characters(mess, line_drawing["US-ASCII"]);
 }
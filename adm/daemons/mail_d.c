@@ -8,129 +8,389 @@
 
  Last edited on August 17th, 2006 by Parthenon
 
+ 2026-10-17 - Gesslar - Each message is now stored once, in its own file
+ under MAIL_STORE_DIR, with a count of the mailboxes that refer to it. A
+ mailbox is an index of message headers kept in an append-only log: every
+ change adds one line, and the log is rewritten only once most of its lines
+ are stale. Indexes are loaded when first used and cached. Bodies are only
+ read when a message is opened. Mailboxes in the old single-file format are
+ converted the first time they are loaded.
+
+ 2026-10-17 - Gesslar - Indexes are read a few hundred lines at a time so a
+ large one never hits the driver's read limit. A mailbox whose index could
+ not be read in full is never compacted, since that would rewrite it from
+ the part that was read.
+
 */
 
 inherit STD_DAEMON;
 
 #define MAIL_DIR "/data/users/"
-
+#define MAIL_STORE_DIR "/data/mail/"
+
+// Mailboxes kept loaded before the cache is emptied
+#define BOX_CACHE_MAX 64
+// Stale index lines allowed beyond the live ones before compaction
+#define BOX_COMPACT_SLACK 32
+// Index lines read at a time when a mailbox is loaded
+#define BOX_READ_LINES 200
+
+// Index log operations
+#define OP_ADD    "+"
+#define OP_READ   "r"
+#define OP_DELETE "-"
+#define OP_CURSOR "c"
+
+// Only used to read mailboxes saved in the old format
 mapping inbox = ([]);
 mapping outbox = ([]);
 int curr_in_msg, curr_out_msg;
 int in_end_index, in_start_index, out_end_index, out_start_index;
 nosave object s_editor;
 
+// user -> ([ "in" : header*, "out" : header*, "cursor" : int*, "records" : int,
+//           "failed" : int ])
+private nosave mapping boxes = ([ ]);
+private nosave int next_id;
+
 string *get_all_members(string *parent_users);
+private mapping load_box(string user);
 
 string get_mail_box_file(string user) {
-    return MAIL_DIR + user[0..0] + "/" + user + "/" + user + ".mail.o";
+    return MAIL_DIR + user[0..0] + "/" + user + "/" + user + ".mail";
 }//END get_mail_box_file
 
-mixed send_message(mapping mail, string owner, int in_msg, int out_msg) {
-    int i, num, index;
-    string *recipients, *cc, *tmp_recipients = ({}), *tmp_cc = ({});
-    string *to_be_notified = ({});
-    mapping inbox_tmp = ([]);
-    mapping outbox_tmp = ([]);
+private string get_legacy_mail_box_file(string user) {
+    return MAIL_DIR + user[0..0] + "/" + user + "/" + user + ".mail.o";
+}
 
-    if(clonep(previous_object())) {
-        index = strsrch(file_name(previous_object()), "#", -1);
+private string get_message_file(string id) {
+    return MAIL_STORE_DIR + id[<2..] + "/" + id;
+}
 
-        if(file_name(previous_object())[0..index-1] != OBJ_MAIL_CLIENT[0..<3])
-            return "You can only do that through the mail client!";
-    }
+private int valid_client() {
+    object ob = previous_object();
+    int index;
 
-    else return "You can only do that through the mail client!";
+    if(!ob || !clonep(ob))
+        return 0;
 
-    if(!mail || !sizeof(mail))
-        return "message was not sent to mail daemon";
+    index = strsrch(file_name(ob), "#", -1);
 
-    if(!mail["TO"] || !sizeof(mail["TO"]))
-        return "no recipients for the message";
+    return file_name(ob)[0..index-1] == OBJ_MAIL_CLIENT[0..<3];
+}
+
+// Headers hold everything the mailbox listings need; only the body stays
+// in the message file.
+private mapping make_header(string id, mapping mail) {
+    return ([
+        "ID"      : id,
+        "FROM"    : replace_string("" + mail["FROM"], "\n", " "),
+        "TO"      : mail["TO"] || ({ }),
+        "CC"      : mail["CC"] || ({ }),
+        "SUBJECT" : replace_string("" + mail["SUBJECT"], "\n", " "),
+        "DATE"    : replace_string("" + mail["DATE"], "\n", " "),
+        "READ"    : mail["READ"] ? 1 : 0,
+    ]);
+}
+
+private string new_message_id() {
+    string id;
+
+    do {
+        id = sprintf("%d%03d", time(), next_id++ % 1000);
+    } while(file_exists(get_message_file(id)));
+
+    return id;
+}
+
+private void write_message(string id, mapping message) {
+    string file = get_message_file(id);
+
+    assure_file(file);
+    write_file(file, save_variable(message), 1);
+}
+
+private mapping read_message_file(string id) {
+    string data = read_file(get_message_file(id));
+    mixed message;
+
+    if(!stringp(data))
+        return 0;
+
+    message = restore_variable(data);
+
+    return mapp(message) ? message : 0;
+}
+
+// Drops one mailbox's reference to a message, removing the message once
+// nothing refers to it.
+private void release_message(string id) {
+    mapping message = read_message_file(id);
+
+    if(!message)
+        return;
+
+    if(--message["REFS"] > 0)
+        write_message(id, message);
+    else
+        rm(get_message_file(id));
+}
+
+private void append_op(string user, mixed *op) {
+    mapping box = boxes[user];
+
+    write_file(get_mail_box_file(user), save_variable(op) + "\n");
+
+    if(box)
+        box["records"]++;
+}
+
+private void compact_box(string user) {
+    mapping box = boxes[user];
+    string *lines = ({ });
+
+    if(box["failed"])
+        return;
+
+    foreach(mapping header in box["in"])
+        lines += ({ save_variable(({ OP_ADD, "in", header })) });
+
+    foreach(mapping header in box["out"])
+        lines += ({ save_variable(({ OP_ADD, "out", header })) });
+
+    lines += ({ save_variable(({ OP_CURSOR, box["cursor"] })) });
+
+    write_file(get_mail_box_file(user), implode(lines, "\n") + "\n", 1);
+    box["records"] = sizeof(lines);
+}
+
+private void maybe_compact_box(string user) {
+    mapping box = boxes[user];
+
+    if(box["failed"])
+        return;
+
+    if(box["records"] > (sizeof(box["in"]) + sizeof(box["out"]) + 1) * 2 + BOX_COMPACT_SLACK)
+        compact_box(user);
+}
+
+// Converts a mailbox saved by the old daemon, writing each of its messages
+// to the store.
+private void migrate_box(string user, mapping box) {
+    string legacy = get_legacy_mail_box_file(user);
+    int i;
 
     inbox = ([]);
     outbox = ([]);
+    curr_in_msg = curr_out_msg = 0;
+    in_start_index = in_end_index = out_start_index = out_end_index = 0;
 
-    if(!s_editor)
-        s_editor = new(OBJ_SECURITY_EDITOR);
+    restore_object(legacy);
 
-    recipients = mail["TO"];
+    for(i = 1; i <= sizeof(inbox); i++) {
+        string id;
 
-    for(i = 0; i < sizeof(recipients); i++) {
-        if(recipients[i][0] == '(' && recipients[i][<1] == ')' && member_array(recipients[i][1..<2], s_editor->list_groups()) != -1)
-            tmp_recipients += filter(get_all_members(master()->query_group(recipients[i])), (: $1[0] != '[' :));
-        else
-            tmp_recipients += ({ lower_case(recipients[i]) });
-    }
+        if(!mapp(inbox[i]))
+            continue;
 
-    recipients = tmp_recipients;
+        id = new_message_id();
+        write_message(id, inbox[i] + ([ "REFS" : 1 ]));
+        box["in"] += ({ make_header(id, inbox[i]) });
+    }
 
-    for(i = 0; i < sizeof(recipients); i++) {
-        if(file_exists(get_mail_box_file(recipients[i]))) {
-            restore_object(get_mail_box_file(recipients[i]));
+    for(i = 1; i <= sizeof(outbox); i++) {
+        string id;
 
-            if(member_array(recipients[i], to_be_notified) == -1)
-                to_be_notified += ({ recipients[i] });
-        }
+        if(!mapp(outbox[i]))
+            continue;
 
-        inbox_tmp = inbox;
-        num = sizeof(inbox_tmp) + 1;
-        mail["READ"] = 0;
-        inbox_tmp[num] = mail;
-        inbox = inbox_tmp;
-        save_object(get_mail_box_file(recipients[i]));
+        id = new_message_id();
+        write_message(id, outbox[i] + ([ "REFS" : 1 ]));
+        box["out"] += ({ make_header(id, outbox[i]) });
     }
 
-    cc = mail["CC"];
+    box["cursor"] = ({ curr_in_msg, curr_out_msg, in_start_index,
+        in_end_index, out_start_index, out_end_index });
 
-    for(i = 0; i < sizeof(cc); i++) {
-        if(cc[i][0] == '(' && cc[i][<1] == ')' && member_array(cc[i][1..<2], s_editor->list_groups()) != -1)
-            tmp_cc += filter(get_all_members(master()->query_group(cc[i])), (: $1[0] != '[' :));
-        else
-            tmp_cc += ({ lower_case(cc[i]) });
+    inbox = ([]);
+    outbox = ([]);
+
+    boxes[user] = box;
+    compact_box(user);
+    rename(legacy, legacy + ".migrated");
+}
+
+private void apply_op(mapping box, mixed *op) {
+    mixed *list;
+
+    box["records"]++;
+
+    switch(op[0]) {
+        case OP_ADD:
+            box[op[1]] += ({ op[2] });
+            break;
+        case OP_READ:
+            foreach(mapping header in box[op[1]])
+                if(header["ID"] == op[2])
+                    header["READ"] = op[3];
+            break;
+        case OP_DELETE:
+            list = box[op[1]];
+            box[op[1]] = filter(list, (: $1["ID"] != $2 :), op[2]);
+            break;
+        case OP_CURSOR:
+            box["cursor"] = op[1];
+            break;
     }
+}
+
+// Replays a mailbox's index in chunks of lines. Returns 0 if a chunk could
+// not be read before the whole file had been.
+private int read_box_index(string user, mapping box) {
+    string file = get_mail_box_file(user);
+    int size = file_size(file), done, start = 1;
+
+    while(done < size) {
+        string data = read_file(file, start, BOX_READ_LINES);
 
-    cc = tmp_cc;
+        if(!stringp(data))
+            return 0;
 
-    for(i = 0; i < sizeof(cc); i++) {
-        if(file_exists(get_mail_box_file(cc[i]))) {
-            if(member_array(cc[i], to_be_notified) == -1)
-                to_be_notified += ({ cc[i] });
+        done += sizeof(string_encode(data, "UTF-8"));
+        start += BOX_READ_LINES;
 
-            restore_object(get_mail_box_file(cc[i]));
+        foreach(string line in explode(data, "\n")) {
+            mixed *op = restore_variable(line);
+
+            if(pointerp(op) && sizeof(op))
+                apply_op(box, op);
         }
+    }
 
-        inbox_tmp = inbox;
-        restore_object(get_mail_box_file(cc[i]));
-        num = sizeof(inbox_tmp) + 1;
-        mail["READ"] = 0;
-        inbox_tmp[num] = mail;
-        inbox = inbox_tmp;
-        save_object(get_mail_box_file(cc[i]));
+    return 1;
+}
+
+private mapping load_box(string user) {
+    mapping box = boxes[user];
+
+    if(box)
+        return box;
+
+    if(sizeof(boxes) >= BOX_CACHE_MAX)
+        boxes = ([ ]);
+
+    box = ([ "in" : ({ }), "out" : ({ }), "cursor" : allocate(6), "records" : 0 ]);
+
+    if(!file_exists(get_mail_box_file(user))) {
+        if(file_exists(get_legacy_mail_box_file(user)))
+            migrate_box(user, box);
+
+        return boxes[user] = box;
     }
 
-    for(i = 0; i < sizeof(to_be_notified); i++)
-        if(find_player(to_be_notified[i]) && find_player(to_be_notified[i])->query_pref("biff") != "off")
-                tell(find_player(to_be_notified[i]),
+    if(!read_box_index(user, box)) {
+        box["failed"] = 1;
+        log_file("system/mail", "[%s] Unable to read the mailbox index of %s\n",
+            ctime(), user);
+    }
 
-                "\n >>> New mail has arrived from: " + mail["FROM"] +
-                "\n >>> Subject: " + mail["SUBJECT"] + "\n\n");
+    return boxes[user] = box;
+}
+
+// Adds a header to a mailbox without loading it, unless it still needs
+// converting from the old format.
+private int deliver(string user, string box_name, mapping header) {
+    string dir = MAIL_DIR + user[0..0] + "/" + user;
+
+    if(file_size(dir) != -2)
+        return 0;
+
+    if(!boxes[user] && !file_exists(get_mail_box_file(user)) &&
+       file_exists(get_legacy_mail_box_file(user)))
+        load_box(user);
+
+    append_op(user, ({ OP_ADD, box_name, header }));
+
+    if(boxes[user]) {
+        boxes[user][box_name] += ({ copy(header) });
+        maybe_compact_box(user);
+    }
+
+    return 1;
+}
+
+private string *expand_recipients(string *list) {
+    string *result = ({});
+    int i;
+
+    for(i = 0; i < sizeof(list); i++) {
+        if(list[i][0] == '(' && list[i][<1] == ')' && member_array(list[i][1..<2], s_editor->list_groups()) != -1)
+            result += filter(get_all_members(master()->query_group(list[i])), (: $1[0] != '[' :));
+        else
+            result += ({ lower_case(list[i]) });
+    }
+
+    return result;
+}
 
-    if(file_exists(get_mail_box_file(owner)))
-        restore_object(get_mail_box_file(owner));
+mixed send_message(mapping mail, string owner, int in_msg, int out_msg) {
+    string *recipients;
+    string id;
+    mapping header;
+    int refs;
+
+    if(!valid_client())
+        return "You can only do that through the mail client!";
+
+    if(!mail || !sizeof(mail))
+        return "message was not sent to mail daemon";
 
-    outbox_tmp = outbox;
-    num = sizeof(outbox_tmp) + 1;
-    outbox_tmp[num] = mail;
-    outbox = outbox_tmp;
-    curr_in_msg = in_msg;
-    curr_out_msg = out_msg;
+    if(!mail["TO"] || !sizeof(mail["TO"]))
+        return "no recipients for the message";
 
-    save_object(get_mail_box_file(owner));
+    if(!s_editor)
+        s_editor = new(OBJ_SECURITY_EDITOR);
+
+    recipients = expand_recipients(mail["TO"]) + expand_recipients(mail["CC"] || ({}));
+    // Someone named twice, or also in a named group, gets one copy.
+    recipients = distinct_array(map(recipients, (: lower_case :)), 1);
 
     if(s_editor)
         s_editor->remove();
 
+    id = new_message_id();
+    mail["READ"] = 0;
+    header = make_header(id, mail);
+
+    // The body is written once; every mailbox only gets a header.
+    foreach(string recipient in recipients) {
+        object ob;
+
+        if(!deliver(recipient, "in", header))
+            continue;
+
+        refs++;
+
+        ob = find_player(recipient);
+        if(ob && ob->query_pref("biff") != "off")
+            tell(ob,
+                "\n >>> New mail has arrived from: " + mail["FROM"] +
+                "\n >>> Subject: " + mail["SUBJECT"] + "\n\n");
+    }
+
+    if(deliver(owner, "out", header))
+        refs++;
+
+    if(refs)
+        write_message(id, mail + ([ "REFS" : refs ]));
+
+    load_box(owner);
+    boxes[owner]["cursor"][0] = in_msg;
+    boxes[owner]["cursor"][1] = out_msg;
+    append_op(owner, ({ OP_CURSOR, boxes[owner]["cursor"] }));
+    maybe_compact_box(owner);
+
     return 1;
 }
 
@@ -149,103 +409,128 @@ string *get_all_members(string *parent_users) {
 }
 
 varargs mixed delete_message(string owner, int num1, int num2, int flag, int curr_msg) {
-    int i, index;
-    mapping tmp_box = ([]);
-    mapping tmp_box2 = ([]);
+    mapping box;
+    mapping *list, *removed;
+    string box_name = flag ? "out" : "in";
 
-    if(clonep(previous_object())) {
-        index = strsrch(file_name(previous_object()), "#", -1);
-
-        if(file_name(previous_object())[0..index-1] != OBJ_MAIL_CLIENT[0..<3])
-            return "You can only do that through the mail client!";
-    }
-    else
+    if(!valid_client())
         return "You can only do that through the mail client!";
 
-    if(file_exists(get_mail_box_file(owner)))
-        restore_object(get_mail_box_file(owner));
-
-    if(flag)
-        tmp_box = outbox;
-    else
-        tmp_box = inbox;
+    box = load_box(owner);
+    list = box[box_name];
 
     if(num1 < 1)
         num1 = 1;
 
-    if(num2 > sizeof(tmp_box))
-        num2 = sizeof(tmp_box);
+    if(num2 > sizeof(list))
+        num2 = sizeof(list);
 
     if(num2 && (num1 > num2))
         return "invalid range selected";
 
-    if(num2) {
-        for(i = 1; i <= sizeof(tmp_box); i++) {
-            if(i < num1)
-                tmp_box2[i] = tmp_box[i];
-            else if(i > num2)
-                tmp_box2[i-(num2-num1+1)] = tmp_box[i];
-        }
-    } else {
-        if(num1 == sizeof(tmp_box)) {
-            map_delete(tmp_box, num1);
-            tmp_box2 = tmp_box;
-        } else {
-            for(i = 1; i <= sizeof(tmp_box); i++) {
-                if(i > num1)
-                    tmp_box2[i-1] = tmp_box[i];
-                else
-                    tmp_box2[i] = tmp_box[i];
-            }
-        }
-    }
+    if(num1 > sizeof(list))
+        return 1;
 
-    if(flag)
-        outbox = tmp_box2;
-    else
-        inbox = tmp_box2;
+    if(!num2)
+        num2 = num1;
+
+    removed = list[num1-1..num2-1];
+    box[box_name] = list[0..num1-2] + list[num2..];
+
+    foreach(mapping header in removed) {
+        append_op(owner, ({ OP_DELETE, box_name, header["ID"] }));
+        release_message(header["ID"]);
+    }
 
     if(flag) {
-        if(curr_msg > sizeof(outbox))
-            curr_out_msg = sizeof(outbox);
+        if(curr_msg > sizeof(box["out"]))
+            box["cursor"][1] = sizeof(box["out"]);
     } else {
-        if(curr_msg > sizeof(inbox))
-            curr_in_msg = sizeof(inbox);
+        if(curr_msg > sizeof(box["in"]))
+            box["cursor"][0] = sizeof(box["in"]);
     }
 
-    save_object(get_mail_box_file(owner));
+    append_op(owner, ({ OP_CURSOR, box["cursor"] }));
+    maybe_compact_box(owner);
 
     return 1;
 }
 
 mapping restore(string user) {
+    mapping box = load_box(user);
     mapping rtn = ([]);
+    int *cursor = box["cursor"];
+    int i;
 
-    if(file_exists(get_mail_box_file(user)))
-        restore_object(get_mail_box_file(user));
+    rtn["inbox"] = ([]);
+    for(i = 0; i < sizeof(box["in"]); i++)
+        rtn["inbox"][i + 1] = copy(box["in"][i]);
 
-    rtn["inbox"] = inbox;
-    rtn["outbox"] = outbox;
-    rtn["curr_in_msg"] = curr_in_msg;
-    rtn["curr_out_msg"] = curr_out_msg;
-    rtn["in_start_index"] = in_start_index;
-    rtn["in_end_index"] = in_end_index;
-    rtn["out_start_index"] = out_start_index;
-    rtn["out_end_index"] = out_end_index;
+    rtn["outbox"] = ([]);
+    for(i = 0; i < sizeof(box["out"]); i++)
+        rtn["outbox"][i + 1] = copy(box["out"][i]);
+
+    rtn["curr_in_msg"] = cursor[0];
+    rtn["curr_out_msg"] = cursor[1];
+    rtn["in_start_index"] = cursor[2];
+    rtn["in_end_index"] = cursor[3];
+    rtn["out_start_index"] = cursor[4];
+    rtn["out_end_index"] = cursor[5];
 
     return rtn;
 }//END restore
 
+// Only read flags and the reading position can change here; anything that
+// did is appended to the index.
 void save(string user, mapping in_box, mapping out_box, int *indices) {
-    inbox = in_box;
-    outbox = out_box;
-    curr_in_msg = indices[0];
-    curr_out_msg = indices[1];
-    in_start_index = indices[2];
-    in_end_index = indices[3];
-    out_start_index = indices[4];
-    out_end_index = indices[5];
-
-    save_object(get_mail_box_file(user));
-    return;
+    mapping box;
+
+    if(!valid_client())
+        return;
+
+    box = load_box(user);
+
+    foreach(string box_name, mapping client_box in ([ "in" : in_box, "out" : out_box ])) {
+        mapping *list = box[box_name];
+        int i;
+
+        for(i = 0; i < sizeof(list); i++) {
+            mapping entry = client_box[i + 1];
+            int read;
+
+            if(!mapp(entry) || entry["ID"] != list[i]["ID"])
+                continue;
+
+            read = entry["READ"] ? 1 : 0;
+            if(read == list[i]["READ"])
+                continue;
+
+            list[i]["READ"] = read;
+            append_op(user, ({ OP_READ, box_name, list[i]["ID"], read }));
+        }
+    }
+
+    if(sizeof(indices) == 6 && save_variable(indices) != save_variable(box["cursor"])) {
+        box["cursor"] = copy(indices);
+        append_op(user, ({ OP_CURSOR, box["cursor"] }));
+    }
+
+    maybe_compact_box(user);
 }//END save
+
+// Returns the body of a message in one of the user's mailboxes.
+string query_body(string user, string id) {
+    mapping box, message;
+
+    if(!valid_client())
+        return 0;
+
+    box = load_box(user);
+
+    if(!sizeof(filter(box["in"] + box["out"], (: $1["ID"] == $2 :), id)))
+        return 0;
+
+    message = read_message_file(id);
+
+    return message ? message["BODY"] : "";
+}
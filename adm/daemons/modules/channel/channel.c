@@ -3,10 +3,11 @@
  * @description Base inheritable for channel modules.
  *
  * @created 2024-09-10 - Gesslar
- * @last_modified 2024-09-10 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-09-10 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Mark the module dirty when history is added
  */
 
 inherit STD_DAEMON;
@@ -42,6 +43,7 @@ void add_history(string channel, string message) {
     history[channel] = ({});
 
   history[channel] += ({ message });
+  mark_dirty();
 }
 
 string *last_messages(string channel, int num_lines) {
@@ -7,13 +7,40 @@
 //Version 2.10
 
 //Last edited by Parthenon on August 6th, 2006
+//2026-10-17 - Gesslar - Ring-buffer history with an append-only log per
+//             channel, compacted periodically. The module's own state is no
+//             longer saved on every message.
+//2026-10-17 - Gesslar - Logs rotate into a few segments by byte size, so
+//             no read ever goes past the driver's read limit.
 
 inherit STD_DAEMON;
 
+// Lines of history kept in memory per channel
+#define RING_SIZE         50
+// Log segments kept per channel, the current one included
+#define LOG_SEGMENTS      3
+// Lines per page of /history
+#define HISTORY_PAGE_SIZE 20
+
 string *ch_list = ({"admin", "wiz", "dev", "chat"});
+// Only read to carry history saved by older versions over to the logs.
 mapping history = ([]);
 private nosave string module_name = query_file_name(this_object());
 
+// chan -> ([ "lines" : string*, "head" : int, "count" : int ])
+private nosave mapping rings = ([ ]);
+// chan -> ([ "lines" : int* per segment, newest first, "bytes" : int ])
+private nosave mapping logs = ([ ]);
+
+private string history_file(string chan);
+private string segment_file(string chan, int segment);
+private string *read_segment(string chan, int segment);
+private void rotate_log(string chan);
+private void load_history(string chan);
+private void push_ring(string chan, string line);
+string *query_recent(string chan, int count);
+string *query_history(string chan, int count, int skip);
+
 void setup() {
     set_persistent();
     set_no_clean(1);
@@ -26,50 +53,238 @@ void post_setup_1() {
 
     for(i = 0; i < sizeof(ch_list); i++) {
         CHAN_D->register_channel(module_name, ch_list[i]);
-        if(history[ch_list[i]] == 0) history[ch_list[i]] = ({ });
+        load_history(ch_list[i]);
+    }
+
+    // Anything still in the old saved history has now been written to the
+    // logs, so it no longer needs saving.
+    if(sizeof(history)) {
+        history = ([]);
+        save_data();
+    }
+}
+
+private string history_file(string chan) {
+    return query_data_file() + "_history/" + chan + ".log";
+}
+
+// A segment never grows much past this, so it can always be read whole.
+private int segment_limit() {
+    return to_int(percent_of(80, get_config(__MAX_READ_FILE_SIZE__)));
+}
+
+// Segment 0 is the one being written; older ones are numbered from 1.
+private string segment_file(string chan, int segment) {
+    string file = history_file(chan);
+
+    return segment ? file + "." + segment : file;
+}
+
+private string *read_segment(string chan, int segment) {
+    string file = segment_file(chan, segment);
+    string data;
+
+    if(file_size(file) <= 0)
+        return ({ });
+
+    data = read_file(file);
+
+    return stringp(data) ? explode(data, "\n") - ({ "" }) : ({ });
+}
+
+// Starts a new current segment, dropping the oldest.
+private void rotate_log(string chan) {
+    mapping log = logs[chan];
+    int i;
+
+    rm(segment_file(chan, LOG_SEGMENTS - 1));
+
+    for(i = LOG_SEGMENTS - 2; i >= 0; i--)
+        if(file_size(segment_file(chan, i)) >= 0)
+            rename(segment_file(chan, i), segment_file(chan, i + 1));
+
+    log["lines"] = ({ 0 }) + log["lines"][0..<2];
+    log["bytes"] = 0;
+}
+
+// Counts the lines in a channel's log segments and fills its ring, writing
+// out any history saved by an older version first.
+private void load_history(string chan) {
+    string file = history_file(chan);
+    string *old, *recent = ({ });
+    int *counts = allocate(LOG_SEGMENTS);
+    int i, size;
+
+    assure_dir(dir_file(file)[0]);
+
+    old = history[chan];
+    if(pointerp(old) && sizeof(old) && file_size(file) < 0)
+        write_file(file, implode(map(old, (: chop($1, "\n", -1) :)), "\n") + "\n");
+
+    logs[chan] = ([ "lines" : counts, "bytes" : 0 ]);
+
+    // A log written before segments were used may be too large to read at
+    // all; set it aside rather than lose the channel's history to it.
+    size = file_size(file);
+    if(size > get_config(__MAX_READ_FILE_SIZE__))
+        rename(file, file + ".old");
+    else if(size > segment_limit())
+        rotate_log(chan);
+
+    for(i = 0; i < LOG_SEGMENTS; i++) {
+        string *lines = read_segment(chan, i);
+
+        counts[i] = sizeof(lines);
+        if(sizeof(recent) < RING_SIZE)
+            recent = lines + recent;
+    }
+
+    logs[chan]["bytes"] = max(({ file_size(file), 0 }));
+
+    rings[chan] = ([ "lines" : allocate(RING_SIZE), "head" : 0, "count" : 0 ]);
+
+    foreach(string line in recent[<RING_SIZE..])
+        push_ring(chan, line);
+}
+
+// Records a line in memory only.
+private void push_ring(string chan, string line) {
+    mapping ring = rings[chan];
+
+    if(!ring)
+        ring = rings[chan] = ([ "lines" : allocate(RING_SIZE), "head" : 0, "count" : 0 ]);
+
+    ring["lines"][ring["head"]] = line;
+    ring["head"] = (ring["head"] + 1) % RING_SIZE;
+    if(ring["count"] < RING_SIZE)
+        ring["count"]++;
+}
+
+// Records a new line in memory and appends it to the channel's log,
+// starting a new segment once the current one is full.
+private void record_history(string chan, string line) {
+    mapping log = logs[chan];
+
+    line = replace_string(line, "\n", " ");
+    push_ring(chan, line);
+
+    if(!log)
+        log = logs[chan] = ([ "lines" : allocate(LOG_SEGMENTS), "bytes" : 0 ]);
+
+    if(log["bytes"] >= segment_limit()) {
+        // The count is in characters, so check the real size first.
+        log["bytes"] = max(({ file_size(history_file(chan)), 0 }));
+        if(log["bytes"] >= segment_limit())
+            rotate_log(chan);
     }
 
-    save_data();
+    if(write_file(history_file(chan), line + "\n")) {
+        log["lines"][0]++;
+        log["bytes"] += strlen(line) + 1;
+    }
+}
+
+// Returns up to count of the most recent lines, oldest first.
+string *query_recent(string chan, int count) {
+    mapping ring = rings[chan];
+    string *result;
+    int i, start;
+
+    if(!ring || count < 1)
+        return ({ });
+
+    if(count > ring["count"])
+        count = ring["count"];
+
+    result = allocate(count);
+    start = ring["head"] - count + RING_SIZE;
+
+    for(i = 0; i < count; i++)
+        result[i] = ring["lines"][(start + i) % RING_SIZE];
+
+    return result;
+}
+
+// Returns up to count lines from the on-disk log, oldest first, ending skip
+// lines before the most recent one. This is how history older than the
+// ring is paged through. Only the segments the page falls in are read.
+string *query_history(string chan, int count, int skip) {
+    mapping log = logs[chan];
+    string *result = ({ });
+    int i;
+
+    if(!log || count < 1 || skip < 0)
+        return ({ });
+
+    if(skip == 0 && count <= RING_SIZE)
+        return query_recent(chan, count);
+
+    for(i = 0; i < LOG_SEGMENTS && count > 0; i++) {
+        string *lines;
+        int start, end;
+
+        if(skip >= log["lines"][i]) {
+            skip -= log["lines"][i];
+            continue;
+        }
+
+        lines = read_segment(chan, i);
+        end = sizeof(lines) - skip;
+        if(end <= 0) {
+            skip = -end;
+            continue;
+        }
+
+        start = end > count ? end - count : 0;
+        result = lines[start..end-1] + result;
+        count -= end - start;
+        skip = 0;
+    }
+
+    return result;
+}
+
+private void show_history(object ob, string chan, string *lines) {
+    if(!sizeof(lines)) {
+        tell(ob, "LocalNet: Channel " + chan + " has no history yet.\n");
+        return;
+    }
+
+    foreach(string hist_line in lines)
+        tell(ob, hist_line + "\n");
 }
 
 int rec_msg(string chan, string usr, string msg) {
     object ob;
     string real_message;
-    int num_lines;
+    int num_lines, page;
 
     if(sscanf(msg, "/last %d", num_lines) == 1) {
-        if(num_lines > sizeof(history[chan]))
-            num_lines = sizeof(history[chan]);
+        show_history(find_player(usr), chan, query_history(chan, num_lines, 0));
+        return 1;
+    } else if(sscanf(msg, "/history %d", page) == 1 || msg == "/history") {
+        string *lines;
+
+        if(page < 1)
+            page = 1;
 
         ob = find_player(usr);
+        lines = query_history(chan, HISTORY_PAGE_SIZE, (page - 1) * HISTORY_PAGE_SIZE);
 
-        if(!sizeof(history[chan]))
-            tell(ob, "LocalNet: Channel " + chan + " has no history yet.\n");
+        if(!sizeof(lines) && page > 1)
+            tell(ob, "LocalNet: Channel " + chan + " has no history that far back.\n");
         else
-            foreach(string hist_line in history[chan][(sizeof(history[chan]) - num_lines)..(sizeof(history[chan]) - 1)])
-        tell(ob, hist_line);
+            show_history(ob, chan, lines);
         return 1;
     } else {
         switch(msg) { /* We could do some neat stuff here! */
             case "/last" : {
-                    ob = find_player(usr);
-
-                    if(!sizeof(history[chan]))
-                        tell(ob, "LocalNet: Channel " + chan + " has no history yet.\n");
-                    else
-                        foreach(string hist_line in history[chan][(sizeof(history[chan]) - 15)..(sizeof(history[chan]) - 1)])
-                    tell(ob, hist_line);
+                    show_history(find_player(usr), chan, query_recent(chan, 15));
                     return 1;
                     break;
                 }
             case "/all" : {
-                    ob = find_player(usr);
-
-                    if(!sizeof(history[chan]))
-                        tell(ob, "LocalNet: Channel " + chan + " has no history yet.\n");
-                    else
-                        foreach(string hist_line in history[chan][(sizeof(history[chan]) - 50)..(sizeof(history[chan]) - 1)])
-                    tell(ob, hist_line);
+                    show_history(find_player(usr), chan, query_recent(chan, 50));
                     return 1;
                     break;
                 }
@@ -85,36 +300,35 @@ int rec_msg(string chan, string usr, string msg) {
     switch(chan) {
         case "admin" : {
                 CHAN_D->rec_msg(chan, lower_case(usr), "[" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n");
-                history[chan] += ({ ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n" });
+                record_history(chan, ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message);
                 break;
             }
 
         case "wiz" : {
                 CHAN_D->rec_msg(chan, lower_case(usr), "[" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n");
-                history[chan] += ({ ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n" });
+                record_history(chan, ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message);
                 break;
             }
 
         case "gossip" : {
                 CHAN_D->rec_msg(chan, lower_case(usr), "[" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n");
-                history[chan] += ({ ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n" });
+                record_history(chan, ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message);
                 break;
             }
 
         case "chat" : {
                 CHAN_D->rec_msg(chan, lower_case(usr), "[" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n");
-                history[chan] += ({ ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n" });
+                record_history(chan, ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message);
                 break;
             }
 
         case "dev" : {
                 CHAN_D->rec_msg(chan, lower_case(usr), "[" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n");
-                history[chan] += ({ ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message + "\n" });
+                record_history(chan, ldate(time(),1) +" "+ltime() + " [" + capitalize(chan) + "] " + capitalize(usr) + real_message);
                 break;
             }
     }
 
-    save_data();
     return 1;
 }
 
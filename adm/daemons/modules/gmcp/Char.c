@@ -13,6 +13,8 @@
 
 inherit STD_DAEMON;
 
+private mapping changed_fields(object who, string package, mapping data);
+
 // This function should present all of the labels that correspond to the
 // variables that are sent in the Char.Status package. The purpose of this
 // is to inform the client what to display, if desired, for each variable
@@ -49,6 +51,10 @@ void Status(object who, mapping payload) {
     GMCP_LBL_CHAR_STATUS_WEALTH      : wealth,
   ]);
 
+  data = changed_fields(who, GMCP_PKG_CHAR_STATUS, data);
+  if(!sizeof(data))
+    return;
+
   who->do_gmcp(GMCP_PKG_CHAR_STATUS, data);
 }
 
@@ -64,9 +70,42 @@ void Vitals(object who, mapping payload) {
     GMCP_LBL_CHAR_VITALS_MAX_MP : sprintf("%.2f", who->query_max_mp()),
   ]);
 
+  data = changed_fields(who, GMCP_PKG_CHAR_VITALS, data);
+  if(!sizeof(data))
+    return;
+
   who->do_gmcp(GMCP_PKG_CHAR_VITALS, data);
 }
 
+// Reduces a payload to the fields whose values differ from what was last
+// sent to the player for this package, and records the new values. Values
+// that are not strings are compared in their serialised form.
+private mapping changed_fields(object who, string package, mapping data) {
+  mapping sent, changed = ([ ]);
+
+  if(!mapp(data))
+    return ([ ]);
+
+  sent = who->query_gmcp_sent(package);
+  if(!mapp(sent))
+    return data;
+
+  foreach(string key, mixed value in data) {
+    mixed compare = stringp(value) ? value : save_variable(value);
+
+    if(of(key, sent) && sent[key] == compare)
+      continue;
+
+    changed[key] = value;
+    sent[key] = compare;
+  }
+
+  if(sizeof(changed))
+    who->set_gmcp_sent(package, sent);
+
+  return changed;
+}
+
 void Login(object who, string submodule, mapping payload) {
   switch(submodule) {
     case "Default" : {
@@ -1,17 +1,44 @@
 // /adm/daemons/persist.c
 // Persist daemon ensures objects are all saved.
 //
+// Persistent objects mark themselves dirty when their saved state changes,
+// and the periodic flush only writes those. Every SWEEP_EVERY heartbeats
+// every registered object is written anyway, for state that changed without
+// being marked. Crashes, shutdowns and explicit persist requests also write
+// every registered object. An object stays dirty until a save of it
+// succeeds.
+//
 // Created:     2024/03/05: Gesslar
-// Last Change: 2024/03/05: Gesslar
+// Last Change: 2026/10/17: Gesslar
 //
 // 2024/03/05: Gesslar - Created
+// 2026/10/17: Gesslar - Dirty tracking and flush statistics
+// 2026/10/17: Gesslar - Periodic full sweep; keep objects dirty until saved
 
 void find_persistent_objects();
 void register_peristent(object ob);
 void unregister_persistent(object ob);
+void mark_dirty(object ob);
+void mark_clean(object ob);
 void persist_objects();
+void flush_dirty();
+private int save_object_data(object ob);
+
+// Heartbeats between full sweeps
+#define SWEEP_EVERY 10
 
 private nosave object *_persistents = ({});
+private nosave mapping _dirty = ([ ]);
+private nosave int _beats = 0;
+private nosave mapping _stats = ([
+  "flushes"       : 0,
+  "last_dirty"    : 0,
+  "last_saved"    : 0,
+  "last_bytes"    : 0,
+  "last_duration" : 0.0,
+  "total_saved"   : 0,
+  "total_bytes"   : 0,
+]);
 
 void setup() {
   set_heart_beat(30);
@@ -22,6 +49,11 @@ void setup() {
 
 void find_persistent_objects() {
   _persistents = objects((: $1->query_persistent() :));
+
+  // Pick up anything that was still waiting when this daemon was reloaded.
+  foreach(object ob in _persistents)
+    if(ob->query_dirty())
+      _dirty[ob] = 1;
 }
 
 void register_peristent(object ob) {
@@ -32,13 +64,108 @@ void register_peristent(object ob) {
 void unregister_persistent(object ob) {
   if(member_array(ob, _persistents) != -1)
     _persistents -= ({ ob });
+
+  map_delete(_dirty, ob);
+}
+
+// Queue an object to be written on the next flush.
+void mark_dirty(object ob) {
+  if(!objectp(ob))
+    return;
+
+  register_peristent(ob);
+  _dirty[ob] = 1;
+}
+
+// Called once an object has written itself, so the flush can skip it.
+void mark_clean(object ob) {
+  map_delete(_dirty, ob);
 }
 
+// Writes every registered object, dirty or not.
 void persist_objects() {
   _persistents -= ({ 0 });
-  catch(filter(_persistents, (: $1->save_data() :)));
+
+  foreach(object ob in _persistents) {
+    int ok;
+
+    if(catch(ok = ob->save_data()) || !ok)
+      continue;
+
+    map_delete(_dirty, ob);
+  }
+}
+
+// Writes only the objects that have changed since they were last saved.
+void flush_dirty() {
+  object *obs;
+  float start;
+  int saved, bytes;
+
+  map_delete(_dirty, 0);
+  obs = keys(_dirty);
+
+  _stats["flushes"]++;
+  _stats["last_dirty"] = sizeof(obs);
+
+  if(!sizeof(obs)) {
+    _stats["last_saved"] = 0;
+    _stats["last_bytes"] = 0;
+    _stats["last_duration"] = 0.0;
+    return;
+  }
+
+  start = time_frac();
+
+  foreach(object ob in obs) {
+    int size;
+
+    if(catch(size = save_object_data(ob)))
+      continue;
+
+    if(size < 0)
+      continue;
+
+    map_delete(_dirty, ob);
+    saved++;
+    bytes += size;
+  }
+
+  _stats["last_saved"] = saved;
+  _stats["last_bytes"] = bytes;
+  _stats["last_duration"] = time_frac() - start;
+  _stats["total_saved"] += saved;
+  _stats["total_bytes"] += bytes;
+}
+
+// Saves one object, returning the size of what was written or -1 if
+// nothing was.
+private int save_object_data(object ob) {
+  string file;
+  int size;
+
+  if(!ob->save_data())
+    return -1;
+
+  file = ob->query_data_file();
+  if(!stringp(file))
+    return 0;
+
+  size = file_size(file + __SAVE_EXTENSION__);
+
+  return size > 0 ? size : 0;
+}
+
+mapping query_flush_stats() {
+  return _stats + ([
+    "registered" : sizeof(_persistents),
+    "pending"    : sizeof(_dirty),
+  ]);
 }
 
 void heart_beat() {
-  persist_objects();
+  if(++_beats % SWEEP_EVERY)
+    flush_dirty();
+  else
+    persist_objects();
 }
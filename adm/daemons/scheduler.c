@@ -0,0 +1,438 @@
+/**
+ * @file /adm/daemons/scheduler.c
+ * @description Central scheduler for short-lived timed callbacks, such as
+ *              combat rounds and delayed acts.
+ *
+ * Callbacks are kept in a hierarchical timing wheel rather than in the
+ * driver's call_out table. A single call_out drives the wheel while anything
+ * is pending, and everything that falls due in the same tick is run
+ * together. Each level has WHEEL_SLOTS slots; level 0 slots are one tick
+ * wide, and each higher level's slots span a full turn of the level below.
+ * Entries are cascaded down a level as their slot comes up.
+ *
+ * A tick stops running callbacks once the evaluation budget runs low; the
+ * rest of that slot stays in the wheel and is run first on the next tick.
+ *
+ * As with a call_out, a callback runs with this_player() set to whoever was
+ * this_player() when it was scheduled. Pending callbacks are handed over
+ * through SWAP_D when the daemon is reloaded.
+ *
+ * @created 2026-10-17 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
+ *
+ * @history
+ * 2026-10-17 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Re-arm before firing and leave what doesn't fit in
+ *                        the evaluation budget for the next tick
+ * 2026-10-17 - Gesslar - Survive reloads, restore this_player() for each
+ *                        callback and only let the owner cancel an entry
+ */
+
+inherit STD_DAEMON;
+
+// Forward declarations
+public varargs int schedule(mixed delay, mixed func, mixed args...);
+public int cancel(int id);
+public int is_scheduled(int id);
+public float query_remaining(int id);
+public mapping query_stats();
+void tick();
+private void insert_entry(int id);
+private int process_tick(int t);
+private int run_slot(int t);
+private void cascade(int level, int t);
+private void fire(int id);
+private int current_real_tick();
+private void ensure_ticking();
+
+// Length of one tick, in seconds
+#define TICK          0.1
+#define WHEEL_BITS    6
+#define WHEEL_SLOTS   (1 << WHEEL_BITS)
+#define WHEEL_MASK    (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS  3
+// Share of the evaluation budget kept back when running a slot
+#define EVAL_RESERVE_DIVISOR 4
+
+// Entry layout
+#define ENTRY_DUE     0
+#define ENTRY_OB      1
+#define ENTRY_FUNC    2
+#define ENTRY_ARGS    3
+#define ENTRY_TP      4
+
+private nosave mixed *_wheel = ({ });
+private nosave mapping _entries = ([ ]);
+private nosave float _epoch;
+private nosave int _current_tick;
+private nosave int _next_id = 1;
+private nosave int _ticker = 0;
+private nosave int _unfinished = 0;
+private nosave int _slot_cursor = 0;
+private nosave float _last_lag = 0.0;
+private nosave float _max_lag = 0.0;
+private nosave int _fired = 0;
+private nosave int _cancelled = 0;
+private nosave int _errors = 0;
+
+void setup() {
+  mapping state = SWAP_D->swap_out("scheduler");
+  int level, slot;
+
+  set_no_clean(1);
+
+  _wheel = allocate(WHEEL_LEVELS);
+  for(level = 0; level < WHEEL_LEVELS; level++) {
+    _wheel[level] = allocate(WHEEL_SLOTS);
+    for(slot = 0; slot < WHEEL_SLOTS; slot++)
+      _wheel[level][slot] = ({ });
+  }
+
+  if(mapp(state)) {
+    _entries = state["entries"];
+    _next_id = state["next_id"];
+    _epoch = state["epoch"];
+  } else {
+    _epoch = time_frac();
+  }
+
+  // Anything that fell due while the daemon was away runs on the next tick.
+  _current_tick = current_real_tick();
+  foreach(int id, mixed *entry in _entries) {
+    if(entry[ENTRY_DUE] <= _current_tick)
+      entry[ENTRY_DUE] = _current_tick + 1;
+
+    insert_entry(id);
+  }
+
+  if(sizeof(_entries))
+    ensure_ticking();
+}
+
+/**
+ * Hands the pending callbacks to SWAP_D for the next instance.
+ */
+void unsetup() {
+  SWAP_D->swap_in("scheduler", ([
+    "entries" : _entries,
+    "next_id" : _next_id,
+    "epoch"   : _epoch,
+  ]));
+}
+
+/**
+ * Schedules a callback to run after a delay.
+ *
+ * If func is a string, it is called in the scheduling object. Otherwise it
+ * must be a function pointer, which is evaluated with the extra arguments.
+ *
+ * @param {int|float} delay - Seconds until the callback runs
+ * @param {string|function} func - The function to call
+ * @param {mixed...} args - Arguments to pass to the callback
+ * @returns {int} The id of the scheduled callback, or 0 on failure
+ */
+public varargs int schedule(mixed delay, mixed func, mixed args...) {
+  object ob = previous_object();
+  int ticks, id;
+
+  if(!stringp(func) && !valid_function(func))
+    return 0;
+
+  if(!intp(delay) && !floatp(delay))
+    return 0;
+
+  // When idle the wheel stops turning, so bring it up to date first.
+  // Anything left of an unfinished slot was cancelled.
+  if(!sizeof(_entries)) {
+    _current_tick = current_real_tick();
+    _unfinished = 0;
+    _slot_cursor = 0;
+  }
+
+  ticks = to_int(ceil(to_float(delay) / TICK));
+  if(ticks < 1)
+    ticks = 1;
+
+  id = _next_id++;
+  _entries[id] = ({ current_real_tick() + ticks, ob, func, args, this_player() });
+  insert_entry(id);
+  ensure_ticking();
+
+  return id;
+}
+
+/**
+ * Cancels a scheduled callback. Only the object that scheduled it may.
+ *
+ * @param {int} id - The id returned by schedule()
+ * @returns {int} 1 if the callback was pending, 0 otherwise
+ */
+public int cancel(int id) {
+  if(!is_scheduled(id))
+    return 0;
+
+  map_delete(_entries, id);
+  _cancelled++;
+
+  return 1;
+}
+
+/**
+ * Checks whether a callback scheduled by the calling object is still
+ * waiting to run.
+ *
+ * @param {int} id - The id returned by schedule()
+ * @returns {int} 1 if it is pending, 0 otherwise
+ */
+public int is_scheduled(int id) {
+  mixed *entry = _entries[id];
+
+  return entry && entry[ENTRY_OB] == previous_object();
+}
+
+/**
+ * Returns the time left before a callback runs.
+ *
+ * @param {int} id - The id returned by schedule()
+ * @returns {float} Seconds remaining, or -1.0 if it is not pending
+ */
+public float query_remaining(int id) {
+  mixed *entry = _entries[id];
+  float remaining;
+
+  if(!entry)
+    return -1.0;
+
+  remaining = _epoch + entry[ENTRY_DUE] * TICK - time_frac();
+
+  return remaining > 0.0 ? remaining : 0.0;
+}
+
+/**
+ * Returns the scheduler's queue depth, lag and counters.
+ *
+ * @returns {mapping} Scheduler statistics
+ */
+public mapping query_stats() {
+  int *depth = allocate(WHEEL_LEVELS);
+  int level;
+
+  for(level = 0; level < WHEEL_LEVELS; level++)
+    foreach(int *slot in _wheel[level])
+      depth[level] += sizeof(slot);
+
+  return ([
+    "pending"     : sizeof(_entries),
+    "slot_depth"  : depth,
+    "tick"        : TICK,
+    "last_lag"    : _last_lag,
+    "max_lag"     : _max_lag,
+    "fired"       : _fired,
+    "cancelled"   : _cancelled,
+    "errors"      : _errors,
+  ]);
+}
+
+/**
+ * Advances the wheel to the present, running everything that has fallen
+ * due on the way.
+ */
+void tick() {
+  int target;
+  float lag;
+
+  // Re-arm first, so that the wheel keeps turning even if this evaluation
+  // is cut short.
+  _ticker = 0;
+  ensure_ticking();
+
+  lag = time_frac() - (_epoch + (_current_tick + 1) * TICK);
+  _last_lag = lag > 0.0 ? lag : 0.0;
+  if(_last_lag > _max_lag)
+    _max_lag = _last_lag;
+
+  // Finish the slot an earlier tick did not get through.
+  if(_unfinished) {
+    if(!run_slot(_current_tick))
+      return;
+
+    _unfinished = 0;
+  }
+
+  target = current_real_tick();
+  while(_current_tick < target && sizeof(_entries)) {
+    // Stays set if the evaluation is cut short, so the next tick resumes.
+    _unfinished = 1;
+    if(!process_tick(++_current_tick))
+      return;
+
+    _unfinished = 0;
+  }
+
+  if(!sizeof(_entries)) {
+    _current_tick = target;
+    _unfinished = 0;
+    _slot_cursor = 0;
+    remove_call_out(_ticker);
+    _ticker = 0;
+  }
+}
+
+/**
+ * Runs the callbacks due at tick t, cascading the higher levels first when
+ * their slots come up.
+ *
+ * @param {int} t - The tick being processed
+ * @returns {int} 1 if the slot was finished, 0 if the budget ran out
+ */
+private int process_tick(int t) {
+  int level;
+
+  for(level = 1; level < WHEEL_LEVELS; level++) {
+    if(t & ((1 << (WHEEL_BITS * level)) - 1))
+      break;
+
+    cascade(level, t);
+  }
+
+  return run_slot(t);
+}
+
+/**
+ * Runs the level 0 slot for tick t. The cursor records how far through the
+ * slot we are, so whatever is left when the evaluation budget runs low, or
+ * the evaluation is aborted, stays there for the next tick.
+ *
+ * @param {int} t - The tick being processed
+ * @returns {int} 1 if the slot was finished, 0 if the budget ran out
+ */
+private int run_slot(int t) {
+  int index = t & WHEEL_MASK;
+  int reserve = max_eval_cost() / EVAL_RESERVE_DIVISOR;
+
+  while(_slot_cursor < sizeof(_wheel[0][index])) {
+    int id;
+    mixed *entry;
+
+    if(eval_cost() < reserve)
+      return 0;
+
+    id = _wheel[0][index][_slot_cursor++];
+
+    entry = _entries[id];
+    if(!entry)
+      continue;
+
+    if(entry[ENTRY_DUE] > t)
+      insert_entry(id);
+    else
+      fire(id);
+  }
+
+  _wheel[0][index] = ({ });
+  _slot_cursor = 0;
+
+  return 1;
+}
+
+/**
+ * Moves the entries of a higher-level slot down to where they now belong.
+ *
+ * @param {int} level - The level to cascade from
+ * @param {int} t - The tick being processed
+ */
+private void cascade(int level, int t) {
+  int index = (t >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  int *slot = _wheel[level][index];
+
+  _wheel[level][index] = ({ });
+
+  foreach(int id in slot)
+    if(of(id, _entries))
+      insert_entry(id);
+}
+
+/**
+ * Places an entry into the slot matching its due tick.
+ *
+ * @param {int} id - The entry to place
+ */
+private void insert_entry(int id) {
+  mixed *entry = _entries[id];
+  int due = entry[ENTRY_DUE];
+  int delta, level;
+
+  if(due < _current_tick)
+    due = _current_tick;
+
+  delta = due - _current_tick;
+
+  for(level = 0; level < WHEEL_LEVELS; level++) {
+    if(delta < (1 << (WHEEL_BITS * (level + 1)))) {
+      _wheel[level][(due >> (WHEEL_BITS * level)) & WHEEL_MASK] += ({ id });
+      return;
+    }
+  }
+
+  // Beyond the horizon, park it in the furthest slot; it will be cascaded
+  // back in each time that slot comes up until it is in range.
+  level = WHEEL_LEVELS - 1;
+  due = _current_tick + (1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+  _wheel[level][(due >> (WHEEL_BITS * level)) & WHEEL_MASK] += ({ id });
+}
+
+/**
+ * Runs a single callback.
+ *
+ * @param {int} id - The entry to run
+ */
+private void fire(int id) {
+  mixed *entry = _entries[id];
+  mixed func = entry[ENTRY_FUNC];
+  object ob = entry[ENTRY_OB];
+  object tp = this_player();
+  string e;
+
+  map_delete(_entries, id);
+
+  if(stringp(func) && !objectp(ob))
+    return;
+
+  // Callbacks such as messaging rely on this_player() being the one who
+  // scheduled them, as it would be in a call_out.
+  set_this_player(entry[ENTRY_TP]);
+
+  if(stringp(func))
+    e = catch(call_other(ob, func, entry[ENTRY_ARGS]...));
+  else
+    e = catch(evaluate(func, entry[ENTRY_ARGS]...));
+
+  set_this_player(tp);
+
+  _fired++;
+
+  if(e) {
+    _errors++;
+    log_file("system/scheduler", sprintf("[%s] Error in %O: %s",
+      ctime(), stringp(func) ? ob : func, e));
+  }
+}
+
+/**
+ * Returns the tick that corresponds to the current time.
+ *
+ * @returns {int} The current tick
+ */
+private int current_real_tick() {
+  return to_int((time_frac() - _epoch) / TICK);
+}
+
+/**
+ * Makes sure the wheel's call_out is running.
+ */
+private void ensure_ticking() {
+  if(_ticker && find_call_out(_ticker) != -1)
+    return;
+
+  _ticker = call_out_walltime("tick", TICK);
+}
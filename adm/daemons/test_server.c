@@ -2,9 +2,14 @@
 // This server is for testing responses.
 //
 // Created:     2024/07/04: Gesslar
-// Last Change: 2024/07/04: Gesslar
+// Last Change: 2026/10/17: Gesslar
 //
 // 2024/07/04: Gesslar - Created
+// 2026/10/17: Gesslar - Echo the request back, so keep-alive and pipelined
+//                       requests can be told apart, eg:
+//                       curl -v http://localhost:8081/a http://localhost:8081/b
+// 2026/10/17: Gesslar - Serve /doc/ through the static asset cache, eg:
+//                       curl -v http://localhost:8081/doc/README
 
 #include <http.h>
 
@@ -26,8 +31,23 @@ void setup() {
 }
 
 void http_handle_request(int fd, mapping client) {
+  mapping request = client["http"]["request"];
+  string route = request["route"]["route"];
   string body;
 
+  if(route[0..4] == "/doc/") {
+    if(strsrch(route, "..") != -1)
+      client["http"]["response"] = ([
+        "status": HTTP_STATUS_FORBIDDEN,
+        "content-type": CONTENT_TYPE_TEXT_PLAIN,
+      ]);
+    else
+      client["http"]["response"] = http_static_response(request, route);
+
+    send_http_response(fd, client);
+    return;
+  }
+
   body = @text
 Hi there, this is a text response! And uhm, we're going to make it
 compressed maybe? Who knows!
@@ -35,6 +55,14 @@ compressed maybe? Who knows!
 Enjoy!
 text;
 
+  body += sprintf("\n%s %s (request %d on this connection)\n",
+    request["request"]["method"], request["request"]["path"], client["served"]);
+
+  if(request["headers"]["content-length"])
+    body += sprintf("Received %d bytes of %s\n",
+      request["headers"]["content-length"],
+      request["headers"]["content-type"] || "unknown content");
+
   client["http"]["response"] = ([
     "status": HTTP_STATUS_OK,
     "content-type": CONTENT_TYPE_TEXT_PLAIN,
@@ -111,6 +111,10 @@ mapping json_encode(mixed arg);
 string pretty_map(mapping map);
 
 // File: messaging.c
+string query_broadcast_render(string message, string profile);
+void begin_broadcast();
+void end_broadcast();
+void set_broadcast_render(string message, string profile, string rendered);
 varargs void tell_up(object ob, string str, int msg_type, mixed exclude);
 varargs void tell_down(object ob, string str, int msg_type, mixed exclude);
 varargs void tell_all(object ob, string str, int msg_type, mixed exclude);
@@ -147,6 +151,7 @@ varargs mixed get_objects(string str, object player, int no_arr);
 varargs object find_ob(mixed ob, mixed cont);
 varargs object get_object(string str, object player);
 varargs object find_targets(object tp, string str, object env, function f);
+varargs object *find_living_targets(object tp, string str, object env, function f);
 varargs object find_target(object tp, string str, object env, function f);
 varargs object *clones(mixed file, int env_only);
 varargs mixed *accessible_objects(object container, object pov);
@@ -214,6 +219,7 @@ int colourp(string str);
 int port();
 object simul_efun();
 mixed mud_config(string str);
+void invalidate_config_snapshot();
 string admin_email();
 string arch();
 string baselib_name();
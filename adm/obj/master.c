@@ -5,6 +5,7 @@
  master object
 
  Last edited on July 14th, 2006 by Tacitus
+ 2026-10-17 - Gesslar - Write-behind buffering for log_file
 
 */
 
@@ -275,6 +276,8 @@ private void crash(string crash_message, object command_giver, object current_ob
   if(current_object)
     log_file("crashes", "this_object: " + file_name(current_object) + "\n");
 
+  flush_logs();
+
   shutdown_d()->shutdown(0);
 }
 
@@ -340,48 +343,150 @@ string make_path_absolute(string file) {
   return file;
 }
 
+// Logs are written behind: messages are buffered per log and written out
+// together, either on a short timer, when a buffer grows past its cap, or
+// when the game shuts down or crashes. The size of each log is tracked in
+// memory so that the rotation check does not stat the file on every write.
+
+// Seconds between flushes while anything is buffered
+#define LOG_FLUSH_INTERVAL 2
+// Bytes buffered for one log before it is flushed immediately
+#define LOG_BUFFER_CAP     16384
+// Bytes buffered across every log before they are all flushed immediately
+#define LOG_TOTAL_CAP      65536
+
+private nosave mapping log_buffers = ([]);
+private nosave mapping log_sizes = ([]);
+private nosave int log_total = 0;
+private nosave int log_flusher = 0;
+
+void flush_logs();
+private void flush_log(string source);
+private void rotate_log(string source);
+
 varargs void log_file(string file, string msg, mixed arg...) {
+  string source, *matches;
   int size;
-  int max_size = percent_of(80, get_config(__MAX_READ_FILE_SIZE__));
-  string *matches;
-  string source;
 
   if(query_privs(previous_object()) == "[open]")
     return;
 
   source = log_dir() + file;
-  size = file_size(source);
 
-  if(size == -2)
-    return;
+  // First write to this log since boot, so find out where it stands.
+  if(nullp(size = log_sizes[source])) {
+    size = file_size(source);
 
-    // Grab the full path and file name from the file
-  matches = dir_file(source);
-  if(sizeof(matches) == 2)
-    assure_dir(matches[0]);
-
-  if(size > max_size) {
-    string reg;
-
-    reg = "^("+log_dir()+")(.*)?/(.*)(\\.log)?$";
-    matches = pcre_extract(source, reg);
-    if(sizeof(matches) >= 2) {
-      string archive;
-      archive = matches[0] + "archive/" + matches[1] + "/";
-      assure_dir(archive);
-      if(sizeof(matches) == 3)
-        archive += matches[2] + "-" + strftime(ARCHIVE_STAMP, time()) + ".log";
-      else
-        archive += matches[2] + "-" + strftime(ARCHIVE_STAMP, time());
-
-      rename(source, archive);
+    if(size == -2) {
+      log_sizes[source] = -2;
+      return;
     }
+
+    // Grab the full path and file name from the file
+    matches = dir_file(source);
+    if(sizeof(matches) == 2)
+      assure_dir(matches[0]);
+
+    log_sizes[source] = size = size < 0 ? 0 : size;
   }
 
+  if(size == -2)
+    return;
+
   msg = sprintf(msg, arg...);
   msg = append(msg, "\n");
 
-  write_file(source, msg);
+  log_buffers[source] = (log_buffers[source] || "") + msg;
+  log_total += strlen(msg);
+
+  if(log_total >= LOG_TOTAL_CAP) {
+    flush_logs();
+    return;
+  }
+
+  if(strlen(log_buffers[source]) >= LOG_BUFFER_CAP) {
+    flush_log(source);
+    return;
+  }
+
+  if(!log_flusher || find_call_out(log_flusher) == -1)
+    log_flusher = call_out("flush_logs", LOG_FLUSH_INTERVAL);
+}
+
+// Writes out every buffered log.
+void flush_logs() {
+  log_flusher = 0;
+
+  foreach(string source in keys(log_buffers))
+    flush_log(source);
+}
+
+// Writes out one buffered log, rotating it first if it has grown too large.
+private void flush_log(string source) {
+  string buf = log_buffers[source];
+  int max_size = percent_of(80, get_config(__MAX_READ_FILE_SIZE__));
+
+  if(nullp(buf))
+    return;
+
+  if(log_sizes[source] > max_size)
+    rotate_log(source);
+
+  if(!write_file(source, buf)) {
+    // Perhaps the directory went away; find out again next time. The lines
+    // stay buffered for the next flush, keeping only the newest if the
+    // writes go on failing.
+    map_delete(log_sizes, source);
+
+    if(strlen(buf) > LOG_TOTAL_CAP) {
+      debug_message(sprintf("log_file: dropped %d bytes for %s after failed writes",
+        strlen(buf) - LOG_TOTAL_CAP, source));
+      log_total -= strlen(buf) - LOG_TOTAL_CAP;
+      log_buffers[source] = buf[<LOG_TOTAL_CAP..];
+    }
+
+    if(!log_flusher || find_call_out(log_flusher) == -1)
+      log_flusher = call_out("flush_logs", LOG_FLUSH_INTERVAL);
+
+    return;
+  }
+
+  map_delete(log_buffers, source);
+  log_total -= strlen(buf);
+  if(log_total < 0)
+    log_total = 0;
+
+  log_sizes[source] += strlen(buf);
+}
+
+// Moves a log into the archive, if it really is as large as we think.
+private void rotate_log(string source) {
+  int max_size = percent_of(80, get_config(__MAX_READ_FILE_SIZE__));
+  int size = file_size(source);
+  string *matches;
+  string reg;
+
+  // Something else may have truncated or removed it behind our back.
+  if(size <= max_size) {
+    log_sizes[source] = size < 0 ? 0 : size;
+    return;
+  }
+
+  reg = "^("+log_dir()+")(.*)?/(.*)(\\.log)?$";
+  matches = pcre_extract(source, reg);
+  if(sizeof(matches) >= 2) {
+    string archive;
+    archive = matches[0] + "archive/" + matches[1] + "/";
+    assure_dir(archive);
+    if(sizeof(matches) == 3)
+      archive += matches[2] + "-" + strftime(ARCHIVE_STAMP, time()) + ".log";
+    else
+      archive += matches[2] + "-" + strftime(ARCHIVE_STAMP, time());
+
+    rename(source, archive);
+  }
+
+  log_sizes[source] = 0;
 }
 
 int save_ed_setup(object user, int config) {
@@ -6,6 +6,10 @@
 
  Refractored 21-DEC-05 by Tacitus @ LPUni
 
+ 2026-10-17 - Gesslar - Access is resolved through a trie of the access
+ directories, and decisions are cached per identity and path prefix. Both
+ are rebuilt whenever the access or group data is parsed.
+
 */
 
 /* Last edited on July 17th, 2006 by Tacitus */
@@ -14,6 +18,7 @@
 
 #define FILE_GROUPDATA "/adm/etc/groups"
 #define FILE_ACCESSDATA "/adm/etc/access"
+#define ACCESS_CACHE_MAX 1024
 //#define DEBUG
 
 /* Global Variable */
@@ -21,6 +26,12 @@
 mapping access = ([]);
 mapping groups = ([]);
 
+/* Access directories ending in '/', one node per path segment. A node's "/"
+   entry holds the access key for the directory it stands for. */
+private nosave mapping access_trie = ([]);
+/* identity + ":" + path prefix -> permission array */
+private nosave mapping access_cache = ([]);
+
 /* Function prototypes */
 
 void parse_group();
@@ -28,6 +39,8 @@ void parse_access();
 string *parse(string *str);
 string *query_group(string group);
 string *track_member(string id, string directory);
+private string resolve_directory(string path);
+private string *resolve_permissions(string id, string directory);
 int query_access(string directory, string id, int type);
 int is_member(string user, string group);
 
@@ -45,6 +58,7 @@ void parse_group() {
 #endif
 
     groups = ([]);
+    access_cache = ([]);
 
     for(i = 0, sz_arr = sizeof(arr); i < sz_arr; i++) {
         string group, str, *members;
@@ -96,6 +110,8 @@ void parse_access() {
 #endif
 
     access = ([]);
+    access_trie = ([]);
+    access_cache = ([]);
 
     for(i = 0, sz_arr = sizeof(arr); i < sz_arr; i++) {
         string directory, str, *entries;
@@ -151,6 +167,17 @@ void parse_access() {
         }
 
         access += ([directory : data]);
+
+        if(directory[<1] == '/') {
+            mapping node = access_trie;
+
+            foreach(string segment in explode(directory, "/")) {
+                if(!node[segment]) node[segment] = ([]);
+                node = node[segment];
+            }
+
+            node["/"] = directory;
+        }
     }
 }
 
@@ -235,7 +262,7 @@ int valid_socket(object caller, string func, mixed *info) {
 }
 
 int valid_read(string file, object user, string func) {
-    string name, tmp, tmp2;
+    string name, home, tmp, tmp2;
 
     if(this_interactive() && query_privs(user) != "[daemon]")
         name = query_privs(this_interactive());
@@ -243,15 +270,14 @@ int valid_read(string file, object user, string func) {
     else name = query_privs(user);
     if(!name) name = "noname";
 
-    if(strlen(file) > strlen(user_data_directory(name))) {
-        if(file[0..(strlen(user_data_directory(name))-1)] == user_data_directory(name))
-            return 1;
-    }
+    home = user_data_directory(name);
+    if(strlen(file) > strlen(home) && file[0..strlen(home)-1] == home)
+        return 1;
 
     if(func == "file_size") return 1;
     if(func == "restore_object" && member_array(find_object("/adm/daemons/finger_d.c"), all_previous_objects()) != -1) return 1;
 
-    if(file && sscanf(file, "/home/%*s/%s/%s", tmp, tmp2)) {
+    if(file && file[0..5] == "/home/" && sscanf(file, "/home/%*s/%s/%s", tmp, tmp2)) {
         if(name == tmp || name == "[home_" + tmp + "]") return 1;
         if(tmp2 && tmp2[0..5] == "public") return 1;
         if(tmp2 && tmp2[0..6] == "private" && name == tmp) return 1;
@@ -267,7 +293,7 @@ int valid_read(string file, object user, string func) {
 }
 
 int valid_write(string file, object user, string func) {
-    string name, tmp, tmp2;
+    string name, home, tmp, tmp2;
     if(this_interactive() && query_privs(user) != "[daemon]")
     name = query_privs(this_interactive());
     else name = query_privs(user);
@@ -275,12 +301,11 @@ int valid_write(string file, object user, string func) {
 
     if(user == this_object() || user == master()) return 1;
 
-    if(strlen(file) > strlen(user_data_directory(name))) {
-        if(file[0..(strlen(user_data_directory(name))-1)] == user_data_directory(name)) return 1;
-    }
-
+    home = user_data_directory(name);
+    if(strlen(file) > strlen(home) && file[0..strlen(home)-1] == home)
+        return 1;
 
-    if(file && sscanf(file, "/home/%*s/%s/%s", tmp, tmp2)) {
+    if(file && file[0..5] == "/home/" && sscanf(file, "/home/%*s/%s/%s", tmp, tmp2)) {
         if(name == tmp || name == "[home_" + tmp + "]") return 1;
         if(tmp2 && tmp2[0..6] == "public/" && tmp2 != "public/") return 1;
         if(tmp2 && tmp2[0..6] == "private" && name == tmp) return 1;
@@ -295,47 +320,80 @@ int valid_write(string file, object user, string func) {
 }
 
 int query_access(string directory, string id, int type) {
-    mapping data;
     string *permissions;
+    string key;
 
 #ifdef DEBUG
 
     write_file("/log/security", "Debug [security]: Permission query for '" + id + "' in '" + directory + "'.\n");
 #endif
 
-    data = access[directory];
+    if(!stringp(directory) || type < 1 || type > 8) return 0;
+
+    /* Anything that is not an access directory itself is decided by the
+       directory it lives in, so that is what the decision is cached under. */
+    if(!access[directory]) {
+        key = directory;
+        if(strlen(key) && key[<1] == '/') key = key[0..<2];
+        key = key[0..strsrch(key, '/', -1)];
+    } else key = directory;
 
-    if(!mapp(data)) {
-        string *exp;
-        int size, i;
+    key = id + ":" + key;
+    permissions = access_cache[key];
+
+    if(!permissions) {
+        if(!access[directory]) directory = resolve_directory(directory);
 
 #ifdef DEBUG
-        write_file("/log/security", "Debug [query_access]: " + directory + " not in mapping. Searching for parent permissions.\n");
+
+        write_file("/log/security", "Debug [query_access]: Final directory set to '" + directory + "'.\n");
+
 #endif
-        exp = explode(directory, "/");
-        size = sizeof(exp);
-        while(!access[directory] && size --) {
-            directory = "/";
-            for(i = 0; i < size; i ++) {
-                directory += exp[i] + "/";
-            }
-        }
 
-        if(!access[directory]) directory = "/";
+        permissions = directory ? resolve_permissions(id, directory) : ({});
+
+        if(sizeof(access_cache) >= ACCESS_CACHE_MAX) access_cache = ([]);
+        access_cache[key] = permissions;
     }
 
-    if(!access[directory]) return 0;
-    else data = access[directory];
+    //read, write, network, shadow, link, execute, bind, ownership
+    if(sizeof(permissions) >= type && permissions[type - 1]) {
+#ifdef DEBUG
+        write_file("/log/security", "Debug [query_access]: Permission granted (" + type + ") for " + directory + "\n");
+#endif
+        return 1;
+    }
 
 #ifdef DEBUG
+    write_file("/log/security", "Debug [query_access]: Permission denied (" + type + ").\n");
+#endif
+    return 0;
+}
 
-    write_file("/log/security", "Debug [query_access]: Final directory set to '" + directory + "'.\n");
+/* Finds the deepest access directory above path, or "/" if none is. */
+private string resolve_directory(string path) {
+    mapping node = access_trie;
+    string directory = access_trie["/"];
 
-#endif
+    if(strlen(path) && path[<1] == '/') path = path[0..<2];
+    path = path[0..strsrch(path, '/', -1)];
+
+    foreach(string segment in explode(path, "/")) {
+        if(!node = node[segment]) break;
+        if(node["/"]) directory = node["/"];
+    }
 
+    return directory;
+}
+
+/* The permissions id has in directory: its own entry, else that of a group
+   it belongs to, else the (all) entry. */
+private string *resolve_permissions(string id, string directory) {
+    mapping data = access[directory];
+    string *permissions;
 
     permissions = data[id];
-    if(!permissions || !pointerp(permissions) || sizeof(permissions) < 1) permissions = track_member(id, directory);
+    if(!pointerp(permissions) || sizeof(permissions) < 1) permissions = track_member(id, directory);
 
     if(sizeof(permissions) < 1) {
 
@@ -347,88 +405,17 @@ int query_access(string directory, string id, int type) {
         permissions = data["(all)"];
     }
 
-
-    if(sizeof(permissions) < 1 || !pointerp(permissions)) {
+    if(!pointerp(permissions)) {
 
 #ifdef DEBUG
 
         write_file("/log/security", "Debug [security]: No permissions found for '" + id + "' in '" + directory + "'.\n");
 
 #endif
-        return 0;
+        return ({});
     }
 
-    switch(type) {
-    //read, write, network, shadow, link, execute, bind, ownership
-        case 1 :
-            if(member_array("r", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to read for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 2 :
-            if(member_array("w", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to write for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 3 :
-            if(member_array("n", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to access network for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 4 :
-            if(member_array("s", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to shadow for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 5 :
-            if(member_array("l", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to link for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 6 :
-            if(member_array("e", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to execute for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 7 :
-            if(member_array("b", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted to bind for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-        case 8 :
-            if(member_array("o", permissions) != -1) {
-#ifdef DEBUG
-                write_file("/log/security", "Debug [query_access]: Permission granted as ownership for " + directory + "\n");
-#endif
-                return 1;
-            }
-            break;
-    }
-#ifdef DEBUG
-    write_file("/log/security", "Debug [query_access]: Permission denied (" + type + ").\n");
-#endif
-    return 0;
+    return permissions;
 }
 
 string *track_member(string id, string directory) {
@@ -5,32 +5,147 @@
  * Provides functions for reading, writing, and manipulating data
  * stored in files using a key-value format.
  *
+ * Each file is one record per line, `key|value|value...`. A file is read
+ * once into an in-memory index the first time it is used. After that, a
+ * change appends a single record to the file instead of rewriting it. A
+ * later record for a key replaces an earlier one, and a line holding only
+ * the key marks it deleted. Once the file holds many more records than live
+ * keys, it is rewritten with one line per key, which is the same format the
+ * old whole-file functions wrote.
+ *
+ * If a file's size changes behind the store's back, its index is thrown
+ * away and the file is read again.
+ *
  * @created Unknown
- * @last_modified 2024-03-11
+ * @last_modified 2026-10-17
+ *
+ * @history
+ * 2026-10-17 - Gesslar - Indexed store with an append log and compaction
  */
 
 #include <simul_efun.h>
 
+// Files whose indexes are kept before the cache is emptied
+#define DATA_CACHE_MAX    256
+// Stale records allowed beyond the live ones before a file is compacted
+#define DATA_COMPACT_SLACK 32
+
+// file -> ([ "index" : ([ key : raw values ]), "records" : int, "size" : int ])
+private nosave mapping _data_stores = ([ ]);
+
 /**
- * Locates the index of a key within a file's contents.
+ * Runs a file operation with the privileges of the object that called the
+ * data function, the same way explode_file() and implode_file() do.
  *
- * Searches through an array of lines to find one starting with the given key.
- * Used internally by the data storage functions.
+ * @param {function} f - The operation to run
+ * @returns {mixed} Whatever the operation returned, or 0 on error
+ * @private
+ */
+private mixed data_as_caller(function f) {
+  string old_privs = query_privs();
+  mixed result;
+
+  set_privs(this_object(), query_privs(previous_object()));
+  catch(result = evaluate(f));
+  set_privs(this_object(), old_privs);
+
+  return result;
+}
+
+/**
+ * Returns the store for a file, reading it into a fresh index if it is not
+ * cached or the file has changed since it was.
  *
- * @param {string*} lines - Array of lines to search through
- * @param {string} key - Key to locate at start of line
- * @returns {int} Line index where key was found, or -1 if not found
+ * @param {string} file - Path to the data file
+ * @returns {mapping} The file's store, or 0 if the file does not exist
  * @private
  */
-private int data_index(string *lines, string key) {
-  int i, sz;
+private mapping data_store(string file) {
+  mapping store = _data_stores[file];
+  mapping index = ([ ]);
+  string data;
+  int size, records;
+
+  size = file_size(file);
+  if(size < 0) {
+    map_delete(_data_stores, file);
+    return 0;
+  }
 
-  for(i = 0, sz = sizeof(lines); i < sz; i++) {
-    if(strsrch(lines[i], key) == 0)
-      return i;
+  if(store && store["size"] == size)
+    return store;
+
+  data = data_as_caller((: read_file, file :));
+  if(!stringp(data))
+    return 0;
+
+  foreach(string line in explode(data, "\n")) {
+    int pos;
+
+    if(!strlen(line) || line[0] == '#')
+      continue;
+
+    records++;
+
+    pos = strsrch(line, '|');
+    if(pos == -1)
+      map_delete(index, line);
+    else
+      index[line[0..pos-1]] = line[pos+1..];
   }
 
-  return -1;
+  if(sizeof(_data_stores) >= DATA_CACHE_MAX)
+    _data_stores = ([ ]);
+
+  store = ([ "index" : index, "records" : records, "size" : size ]);
+  _data_stores[file] = store;
+
+  return store;
+}
+
+/**
+ * Rewrites a file with one line per live key.
+ *
+ * @param {string} file - Path to the data file
+ * @param {mapping} store - The file's store
+ * @private
+ */
+private void data_compact(string file, mapping store) {
+  mapping index = store["index"];
+  string *lines;
+
+  if(!sizeof(index)) {
+    data_as_caller((: rm, file :));
+    map_delete(_data_stores, file);
+    return;
+  }
+
+  lines = map(keys(index), (: $1 + "|" + $(index)[$1] :));
+  data_as_caller((: write_file, file, implode(lines, "\n") + "\n", 1 :));
+
+  store["records"] = sizeof(lines);
+  store["size"] = file_size(file);
+}
+
+/**
+ * Appends one record to a file, compacting it instead if too many of its
+ * records are stale.
+ *
+ * @param {string} file - Path to the data file
+ * @param {mapping} store - The file's store, already updated
+ * @param {string} line - The record to append
+ * @private
+ */
+private void data_append(string file, mapping store, string line) {
+  if(store["records"] + 1 > sizeof(store["index"]) * 2 + DATA_COMPACT_SLACK) {
+    data_compact(file, store);
+    return;
+  }
+
+  data_as_caller((: write_file, file, line + "\n" :));
+
+  store["records"]++;
+  store["size"] = file_size(file);
 }
 
 /**
@@ -50,26 +165,25 @@ private int data_index(string *lines, string key) {
  * mixed *stats = data_value("/save/player.dat", "stats", ({10, 10, 10}));
  */
 varargs mixed data_value(string file, string key, mixed def) {
-  string *lines, line;
+  mapping store;
   mixed *parts;
-  int i, sz;
+  string raw;
 
   if(nullp(file) || nullp(key))
     return null;
 
-  if(!file_exists(file))
+  if(!master()->valid_read(file, previous_object(), "read_file"))
     return null;
 
-  key = append(key, "|");
-  lines = explode_file(file);
-  i = data_index(lines, key);
-  if(i == -1)
+  store = data_store(file);
+  if(!store)
+    return null;
+
+  raw = store["index"][key];
+  if(nullp(raw))
     return def;
 
-  line = lines[i];
-  parts = explode(line, "|");
-  parts = parts[1..];
-  parts = map(parts, (: from_string :));
+  parts = map(explode(raw, "|"), (: from_string :));
   if(sizeof(parts) == 1)
     return parts[0];
 
@@ -92,27 +206,28 @@ varargs mixed data_value(string file, string key, mixed def) {
  * data_write("/save/player.dat", "stats", 10, 12, 15);
  */
 varargs void data_write(string file, string key, mixed data...) {
-  string *lines, out;
-  mixed *parts;
-  int i;
+  mapping store;
+  string raw;
+
+  if(nullp(file) || nullp(key) || nullp(data) || !sizeof(data))
+    return;
 
-  if(nullp(file) || nullp(key) || nullp(data))
+  if(!master()->valid_write(file, previous_object(), "write_file"))
     return;
 
-  parts = map(data, (: stringify :));
-  out = implode(parts, "|");
-  key = append(key, "|");
-  out = key + out;
+  raw = implode(map(data, (: stringify :)), "|");
 
-  lines = explode_file(file);
-  i = data_index(lines, key);
-  if(i > -1) {
-    lines[i] = out;
-    implode_file(file, lines, 1);
+  store = data_store(file);
+  if(!store) {
+    data_as_caller((: write_file, file, key + "|" + raw + "\n", 1 :));
     return;
   }
 
-  implode_file(file, lines, 1);
+  if(store["index"][key] == raw)
+    return;
+
+  store["index"][key] = raw;
+  data_append(file, store, key + "|" + raw);
 }
 
 /**
@@ -130,22 +245,24 @@ varargs void data_write(string file, string key, mixed data...) {
  * }
  */
 int data_del(string file, string key) {
-  string *lines;
-  int i;
+  mapping store;
 
   if(nullp(file) || nullp(key))
     return 0;
 
-  lines = explode_file(file);
-  i = data_index(lines, key);
-  if(i == -1)
+  if(!master()->valid_write(file, previous_object(), "write_file"))
     return 0;
 
-  lines = lines[0..i-1] + lines[i+1..];
-  if(sizeof(lines) == 0)
-    rm(file);
+  store = data_store(file);
+  if(!store || !of(key, store["index"]))
+    return 0;
+
+  map_delete(store["index"], key);
+
+  if(!sizeof(store["index"]))
+    data_compact(file, store);
   else
-    implode_file(file, lines, 1);
+    data_append(file, store, key);
 
   return 1;
 }
@@ -168,8 +285,9 @@ int data_del(string file, string key) {
  * printf("Total kills: %d\n", kills);
  */
 varargs int data_inc(string file, string key, int inc) {
-  string *lines, line;
-  int i, val;
+  mapping store;
+  string raw;
+  int val;
 
   if(nullp(file) || nullp(key))
     return null;
@@ -180,17 +298,22 @@ varargs int data_inc(string file, string key, int inc) {
   if(inc == 0)
     return data_value(file, key);
 
-  lines = explode_file(file);
-  i = data_index(lines, key);
-  if(i == -1) {
+  if(!master()->valid_write(file, previous_object(), "write_file"))
+    return null;
+
+  store = data_store(file);
+  if(!store) {
     data_write(file, key, inc);
     return inc;
   }
 
-  key = append(key, "|");
-  line = lines[i];
-  sscanf(line, key + "%d", val);
+  raw = store["index"][key];
+  if(stringp(raw))
+    sscanf(raw, "%d", val);
+
   val += inc;
-  lines[i] = key + val;
-  implode_file(file, lines, 1);
+  store["index"][key] = sprintf("%d", val);
+  data_append(file, store, key + "|" + val);
+
+  return val;
 }
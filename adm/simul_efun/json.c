@@ -20,6 +20,9 @@
  * v1.0.4: Removed array keyword. (Yucong Sun)
  * v1.0.5: Fix decoding number 0.
  * v1.1.0: Adding unicode support for complex emoji, etc
+ * v1.2.0: Tokenize with a single pcre_assoc pass and parse from a cursor
+ *         over the tokens; the encoder joins collected parts once and has
+ *         fast paths for flat mappings and arrays (Gesslar)
  *
  * LICENSE
  *
@@ -50,608 +53,378 @@
 
 #define to_string(x)                ("" + (x))
 
-#define JSON_DECODE_PARSE_TEXT      0
-#define JSON_DECODE_PARSE_POS       1
-#define JSON_DECODE_PARSE_LINE      2
-#define JSON_DECODE_PARSE_CHAR      3
-#define JSON_DECODE_PARSE_FIELDS    4
-
-private mixed json_decode_parse_value(mixed* parse);
-private varargs mixed json_decode_parse_string(mixed* parse, int initiator_checked);
+// Token ids from the tokenizer; unmatched text comes back as JSON_TOKEN_NONE
+#define JSON_TOKEN_NONE             0
+#define JSON_TOKEN_STRING           1
+#define JSON_TOKEN_NUMBER           2
+#define JSON_TOKEN_PUNCT            3
+#define JSON_TOKEN_LITERAL          4
+#define JSON_TOKEN_SPACE            5
+
+// Parser frame layout
+#define JSON_FRAME_KIND             0
+#define JSON_FRAME_VALUE            1
+#define JSON_FRAME_COUNT            2
+#define JSON_FRAME_KEY              3
+#define JSON_FRAME_HAS_KEY          4
+
+// Most encoded strings and keys kept before the caches are emptied
+#define JSON_CACHE_MAX              1024
+
+private nosave nomask string *json_token_patterns = ({
+    "\"[^\"\\\\]*+(?:\\\\.[^\"\\\\]*+)*+\"",
+    "-?(?:0|[1-9][0-9]*)(?:\\.[0-9]+)?(?:[eE][-+]?[0-9]+)?",
+    "[{}\\[\\],:]",
+    "true|false|null",
+    "[ \\t\\r\\n\\f]+",
+});
+
+private nosave nomask int *json_token_ids = ({
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_PUNCT,
+    JSON_TOKEN_LITERAL,
+    JSON_TOKEN_SPACE,
+});
+
+private nosave nomask string json_unescape_pattern = "\\\\u[0-9a-fA-F]{4}|\\\\.";
+
+// Characters that must be escaped when encoding a string
+private nosave nomask string json_escape_pattern = "[\"\\\\\\x00-\\x1f\\x{80}-\\x{10FFFF}]";
+
+private nosave mapping json_escapes = ([ ]);
+private nosave mapping json_keys = ([ ]);
 
 /**
- * @function json_decode_parse_next_char
- * @description Advances the parse position by one character.
- * @param {mixed[]} parse - The parse state array.
+ * @function json_decode_parse_error
+ * @description Raises a parse error at a token, working out its line and
+ *              character only now that they are needed.
+ * @param {string[]} pieces - The tokenized text.
+ * @param {int} index - The index of the offending token.
+ * @param {string} msg - The error message.
  */
-private void json_decode_parse_next_char(mixed* parse) {
-    parse[JSON_DECODE_PARSE_POS]++;
-    parse[JSON_DECODE_PARSE_CHAR]++;
-}
+private void json_decode_parse_error(string *pieces, int index, string msg) {
+    string before = implode(pieces[0..index-1], "");
+    int line = strlen(before) - strlen(replace_string(before, "\n", "")) + 1;
+    int ch = strlen(before) - strsrch(before, "\n", -1);
 
-/**
- * @function json_decode_parse_next_chars
- * @description Advances the parse position by the specified number of characters.
- * @param {mixed[]} parse - The parse state array.
- * @param {int} num - The number of characters to advance.
- */
-private void json_decode_parse_next_chars(mixed* parse, int num) {
-    parse[JSON_DECODE_PARSE_POS] += num;
-    parse[JSON_DECODE_PARSE_CHAR] += num;
-}
+    if(index < sizeof(pieces) && strlen(pieces[index]))
+        msg = sprintf("%s, '%s'", msg, pieces[index][0..0]);
 
-/**
- * @function json_decode_parse_next_line
- * @description Advances the parse position to the next line.
- * @param {mixed[]} parse - The parse state array.
- */
-private void json_decode_parse_next_line(mixed* parse) {
-    parse[JSON_DECODE_PARSE_POS]++;
-    parse[JSON_DECODE_PARSE_LINE]++;
-    parse[JSON_DECODE_PARSE_CHAR] = 1;
+    error(sprintf("%s @ line %d char %d\n", msg, line, ch));
 }
 
 /**
- * @function json_decode_skip_whitespaces
- * @description Skips whitespace characters in the parse state.
- * @param {mixed[]} parse - The parse state array.
+ * @function json_decode_unescape
+ * @description Decodes the escape sequences in the body of a JSON string.
+ * @param {string} str - The string body, without its quotes.
+ * @returns {string} - The decoded string.
  */
-private void json_decode_skip_whitespaces(mixed* parse) {
-    int ch;
-    while(1) {
-      json_decode_parse_next_char(parse);
-      ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-      if(ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t') {
-        continue;
-      } else {
-        return;
-      }
-    }
-}
+private string json_decode_unescape(string str) {
+    mixed *assoc = pcre_assoc(str, ({ json_unescape_pattern }), ({ 1 }), 0);
+    string *pieces = assoc[0];
+    int *ids = assoc[1];
+    int i, sz = sizeof(pieces);
+
+    for(i = 0; i < sz; i++) {
+        string piece;
+        int code, low;
+
+        if(!ids[i])
+            continue;
+
+        piece = pieces[i];
+
+        if(piece[1] != 'u') {
+            switch(piece[1]) {
+            case 'b'    : pieces[i] = "\b"; break;
+            case 'f'    : pieces[i] = "\x0c"; break;
+            case 'n'    : pieces[i] = "\n"; break;
+            case 'r'    : pieces[i] = "\r"; break;
+            case 't'    : pieces[i] = "\t"; break;
+            default     : pieces[i] = piece[1..1]; break;
+            }
+            continue;
+        }
 
-/**
- * @function json_decode_hexdigit
- * @description Converts a hexadecimal character to its integer value.
- * @param {int} ch - The hexadecimal character.
- * @returns {int} - The integer value of the hexadecimal character.
- */
-private int json_decode_hexdigit(int ch) {
-    switch(ch) {
-    case '0'    :
-        return 0;
-    case '1'    :
-    case '2'    :
-    case '3'    :
-    case '4'    :
-    case '5'    :
-    case '6'    :
-    case '7'    :
-    case '8'    :
-    case '9'    :
-        return ch - '0';
-    case 'a'    :
-    case 'A'    :
-        return 10;
-    case 'b'    :
-    case 'B'    :
-        return 11;
-    case 'c'    :
-    case 'C'    :
-        return 12;
-    case 'd'    :
-    case 'D'    :
-        return 13;
-    case 'e'    :
-    case 'E'    :
-        return 14;
-    case 'f'    :
-    case 'F'    :
-        return 15;
+        sscanf(piece[2..], "%x", code);
+
+        // A high surrogate directly followed by a low one is a single
+        // character outside the basic plane.
+        if(code >= 0xD800 && code <= 0xDBFF && i + 2 < sz &&
+           pieces[i + 1] == "" && ids[i + 2] && pieces[i + 2][1] == 'u') {
+            sscanf(pieces[i + 2][2..], "%x", low);
+            if(low >= 0xDC00 && low <= 0xDFFF) {
+                pieces[i] = sprintf("%c", 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00));
+                pieces[i + 2] = "";
+                i += 2;
+                continue;
+            }
+        }
+
+        pieces[i] = sprintf("%c", code);
     }
-    return -1;
+
+    return implode(pieces, "");
 }
 
 /**
- * @function json_decode_parse_at_token
- * @description Checks if the parse position matches the specified token.
- * @param {mixed[]} parse - The parse state array.
- * @param {string} token - The token to check for.
- * @param {int} [start=0] - The starting position to check from.
- * @returns {int} - 1 if the token matches, otherwise 0.
+ * @function json_decode_token_value
+ * @description Converts a string, number or literal token into its value.
+ * @param {string} piece - The token text.
+ * @param {int} id - The token id.
+ * @returns {mixed} - The value of the token.
  */
-private varargs int json_decode_parse_at_token(mixed* parse, string token, int start) {
-    int i, j;
-    for(i = start, j = strlen(token); i < j; i++)
-        if(parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS] + i] != token[i])
+private mixed json_decode_token_value(string piece, int id) {
+    switch(id) {
+    case JSON_TOKEN_STRING :
+        piece = piece[1..<2];
+        if(strsrch(piece, '\\') != -1)
+            return json_decode_unescape(piece);
+        return piece;
+    case JSON_TOKEN_NUMBER :
+        if(strsrch(piece, '.') != -1 || strsrch(piece, 'e') != -1 || strsrch(piece, 'E') != -1)
+            return to_float(piece);
+        return to_int(piece);
+    case JSON_TOKEN_LITERAL :
+        if(piece == "true")
+            return 1;
+        if(piece == "false")
             return 0;
-    return 1;
-}
+        return ([])[0] ; // undefined
+    }
 
-/**
- * @function json_decode_parse_error
- * @description Raises a parse error with the specified message and character.
- * @param {mixed[]} parse - The parse state array.
- * @param {string} msg - The error message.
- * @param {int} [ch] - The character causing the error.
- */
-private varargs void json_decode_parse_error(mixed* parse, string msg, int ch) {
-    if(ch)
-        msg = sprintf("%s, '%c'", msg, ch);
-    msg = sprintf("%s @ line %d char %d\n", msg, parse[JSON_DECODE_PARSE_LINE], parse[JSON_DECODE_PARSE_CHAR]);
-    error(msg);
+    return 0;
 }
 
 /**
- * @function json_decode_parse_object
- * @description Parses a JSON object from the given parse state.
- * @param {mixed[]} parse - The parse state array.
- * @returns {mapping} - The parsed JSON object.
+ * @simul_efun json_decode
+ * @description Deserializes a JSON string into an LPC value.
+ * @param {string} text - The JSON string to deserialize.
+ * @returns {mixed} - The deserialized LPC value.
  */
-private mixed json_decode_parse_object(mixed* parse) {
-    mapping out = ([]);
-    int done = 0;
-    mixed key, value;
-    int found_non_whitespace, found_sep, found_comma;
-    json_decode_parse_next_char(parse);
-    if(parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]] == '}') {
-        done = 1;
-        json_decode_parse_next_char(parse);
+mixed json_decode(string text) {
+    mixed *assoc, *stack = ({ }), *frame;
+    string *pieces;
+    int *ids;
+    mixed value;
+    int i, sz, id, value_at;
+    string piece;
+
+    if(!text) {
+      return 0;
     }
-    while(!done) {
-        found_non_whitespace = 0;
-        while(!found_non_whitespace) {
-            switch(parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]]) {
-            case 0      :
-                json_decode_parse_error(parse, "Unexpected end of data");
-            case ' '    :
-            case '\t'   :
-            case '\r'   :
-                json_decode_parse_next_char(parse);
-                break;
-            case 0x0c   :
-            case '\n'   :
-                json_decode_parse_next_line(parse);
-                break;
-            default     :
-                found_non_whitespace = 1;
-                break;
-            }
-        }
-        key = json_decode_parse_string(parse);
-        found_sep = 0;
-        while(!found_sep) {
-            int ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-            switch(ch) {
-            case 0      :
-                json_decode_parse_error(parse, "Unexpected end of data");
-            case ':'    :
-                found_sep = 1;
-                json_decode_parse_next_char(parse);
-                break;
-            case ' '    :
-            case '\t'   :
-            case '\r'   :
-                json_decode_parse_next_char(parse);
-                break;
-            case 0x0c   :
-            case '\n'   :
-                json_decode_parse_next_line(parse);
-                break;
-            default     :
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            }
-        }
-        value = json_decode_parse_value(parse);
-        found_comma = 0;
-        while(!found_comma && !done) {
-            int ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-            switch(ch) {
-            case 0      :
-                json_decode_parse_error(parse, "Unexpected end of data");
-            case ','    :
-                found_comma = 1;
-                json_decode_parse_next_char(parse);
-                break;
+
+    // Split the whole text into tokens in one pass; anything that is not a
+    // token comes back with JSON_TOKEN_NONE.
+    assoc = pcre_assoc(text, json_token_patterns, json_token_ids, JSON_TOKEN_NONE);
+    pieces = assoc[0];
+    ids = assoc[1];
+    sz = sizeof(pieces);
+
+    while(1) {
+        // Move to the next token
+        while(i < sz && (ids[i] == JSON_TOKEN_SPACE || pieces[i] == ""))
+            i++;
+
+        if(i >= sz)
+            json_decode_parse_error(pieces, i, "Unexpected end of data");
+
+        id = ids[i];
+        piece = pieces[i];
+        value_at = i;
+
+        if(id == JSON_TOKEN_NONE)
+            json_decode_parse_error(pieces, i, "Unexpected character");
+
+        if(id == JSON_TOKEN_PUNCT) {
+            switch(piece[0]) {
+            case '{'    :
+                stack += ({ ({ '{', ([ ]), 0, 0, 0 }) });
+                i++;
+                continue;
+            case '['    :
+                stack += ({ ({ '[', allocate(8), 0, 0, 0 }) });
+                i++;
+                continue;
             case '}'    :
-                done = 1;
-                json_decode_parse_next_char(parse);
-                break;
-            case ' '    :
-            case '\t'   :
-            case '\r'   :
-                json_decode_parse_next_char(parse);
-                break;
-            case 0x0c   :
-            case '\n'   :
-                json_decode_parse_next_line(parse);
+            case ']'    :
+                // Only an empty container may close here; anything else
+                // closes after a value below.
+                if(!sizeof(stack) || stack[<1][JSON_FRAME_COUNT] ||
+                   stack[<1][JSON_FRAME_HAS_KEY] ||
+                   stack[<1][JSON_FRAME_KIND] != (piece[0] == '}' ? '{' : '['))
+                    json_decode_parse_error(pieces, i, "Unexpected character");
+                value = piece[0] == '}' ? ([ ]) : ({ });
+                stack = stack[0..<2];
+                i++;
                 break;
             default     :
-                json_decode_parse_error(parse, "Unexpected character", ch);
+                json_decode_parse_error(pieces, i, "Unexpected character");
             }
+        } else {
+            value = json_decode_token_value(piece, id);
+            i++;
         }
-        out[key] = value;
-    }
-    return out;
-}
 
-/**
- * @function json_decode_parse_array
- * @description Parses a JSON array from the given parse state.
- * @param {mixed[]} parse - The parse state array.
- * @returns {mixed[]} - The parsed JSON array.
- */
-private mixed json_decode_parse_array(mixed* parse) {
-    mixed* out = ({});
-    int done = 0;
-    int found_comma;
-    json_decode_parse_next_char(parse);
-    if(parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]] == ']') {
-        done = 1;
-        json_decode_parse_next_char(parse);
-    }
-    while(!done) {
-        mixed value = json_decode_parse_value(parse);
-        found_comma = 0;
-        while(!found_comma && !done) {
-            int ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-            switch(ch) {
-            case 0      :
-                json_decode_parse_error(parse, "Unexpected end of data");
-            case ','    :
-                found_comma = 1;
-                json_decode_parse_next_char(parse);
-                break;
-            case ']'    :
-                done = 1;
-                json_decode_parse_next_char(parse);
-                break;
-            case ' '    :
-            case '\t'   :
-            case '\r'   :
-                json_decode_parse_next_char(parse);
-                break;
-            case 0x0c   :
-            case '\n'   :
-                json_decode_parse_next_line(parse);
-                break;
-            default     :
-                json_decode_parse_error(parse, "Unexpected character", ch);
+        // Hand the value to its container, closing containers as they end.
+        while(1) {
+            if(!sizeof(stack)) {
+                while(i < sz && (ids[i] == JSON_TOKEN_SPACE || pieces[i] == ""))
+                    i++;
+                if(i < sz)
+                    json_decode_parse_error(pieces, i, "Unexpected character");
+                return value;
             }
-        }
-        out += ({ value });
-    }
-    return out;
-}
 
-/**
- * @function json_decode_parse_string
- * @description Parses a JSON string from the given parse state.
- * @param {mixed[]} parse - The parse state array.
- * @param {int} [initiator_checked=0] - Whether the initiator has been checked.
- * @returns {string} - The parsed JSON string.
- */
-private varargs mixed json_decode_parse_string(mixed* parse, int initiator_checked) {
-    int from, to, esc_state, esc_active;
-    string out;
-    if(!initiator_checked) {
-        int ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-        if(!ch)
-            json_decode_parse_error(parse, "Unexpected end of data");
-        if(ch != '"')
-            json_decode_parse_error(parse, "Unexpected character", ch);
-    }
-    json_decode_parse_next_char(parse);
-    from = parse[JSON_DECODE_PARSE_POS];
-    to = -1;
-    esc_state = 0;
-    esc_active = 0;
-    while(to == -1) {
-        switch(parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]]) {
-        case 0          :
-            json_decode_parse_error(parse, "Unexpected end of data");
-        case '\\'       :
-            esc_state = !esc_state;
-            break;
-        case '"'        :
-            if(esc_state) {
-                esc_state = 0;
-                esc_active++;
+            frame = stack[<1];
+
+            while(i < sz && (ids[i] == JSON_TOKEN_SPACE || pieces[i] == ""))
+                i++;
+
+            if(frame[JSON_FRAME_KIND] == '{') {
+                if(!frame[JSON_FRAME_HAS_KEY]) {
+                    if(ids[value_at] != JSON_TOKEN_STRING)
+                        json_decode_parse_error(pieces, value_at, "Unexpected character");
+                    if(i >= sz || pieces[i] != ":")
+                        json_decode_parse_error(pieces, i, i >= sz ? "Unexpected end of data" : "Unexpected character");
+                    frame[JSON_FRAME_KEY] = value;
+                    frame[JSON_FRAME_HAS_KEY] = 1;
+                    i++;
+                    break;
+                }
+
+                frame[JSON_FRAME_VALUE][frame[JSON_FRAME_KEY]] = value;
+                frame[JSON_FRAME_HAS_KEY] = 0;
+                frame[JSON_FRAME_COUNT]++;
             } else {
-                to = parse[JSON_DECODE_PARSE_POS] - 1;
+                if(frame[JSON_FRAME_COUNT] == sizeof(frame[JSON_FRAME_VALUE]))
+                    frame[JSON_FRAME_VALUE] += allocate(frame[JSON_FRAME_COUNT]);
+                frame[JSON_FRAME_VALUE][frame[JSON_FRAME_COUNT]++] = value;
             }
-            break;
-        default         :
-            if(esc_state) {
-                esc_state = 0;
-                esc_active++;
-            }
-            break;
-        }
-        json_decode_parse_next_char(parse);
-    }
-    out = string_decode(parse[JSON_DECODE_PARSE_TEXT][from .. to], "utf-8");
-    if(esc_active) {
-        if(member_array('"', out) != -1)
-            out = replace_string(out, "\\\"", "\"");
-        if(strsrch(out, "\\b") != -1)
-            out = replace_string(out, "\\b", "\b");
-        if(strsrch(out, "\\f") != -1)
-            out = replace_string(out, "\\f", "\x0c");
-        if(strsrch(out, "\\n") != -1)
-            out = replace_string(out, "\\n", "\n");
-        if(strsrch(out, "\\r") != -1)
-            out = replace_string(out, "\\r", "\r");
-        if(strsrch(out, "\\t") != -1)
-            out = replace_string(out, "\\t", "\t");
-        if(strsrch(out, "\\u") != -1) {
-            int i, k, character, next_character;
-            string new_out = "";
-
-            i = 0;
-            while(i < strlen(out)) {
-                if(out[i] == '\\' && i + 1 < strlen(out) && out[i + 1] == 'u') {
-                    string unicode_sequence = "";
-                    int sequence_length;
-                    string decoded_char;
-
-                    while(i + 5 < strlen(out) && out[i] == '\\' && out[i + 1] == 'u') {
-                        unicode_sequence += out[i..i+5];
-                        i += 6;
-                    }
-                    i--; // Adjust for the outer loop increment
-
-                    sequence_length = strlen(unicode_sequence) / 6;
-                    decoded_char = "";
-
-                    for(k = 0; k < sequence_length; k++) {
-                        sscanf(unicode_sequence[k*6+2..k*6+5], "%x", character);
-
-                        if(k + 1 < sequence_length &&
-                        character >= 0xD800 && character <= 0xDBFF) {
-                            // This is a high surrogate, look for low surrogate
-                            sscanf(unicode_sequence[(k+1)*6+2..(k+1)*6+5], "%x", next_character);
-                            if(next_character >= 0xDC00 && next_character <= 0xDFFF) {
-                                // Valid surrogate pair
-                                int codepoint = 0x10000 + ((character - 0xD800) << 10) + (next_character - 0xDC00);
-                                decoded_char += sprintf("%c", codepoint);
-                                k++; // Skip the next character as we've used it
-                            } else {
-                                decoded_char += sprintf("%c", character);
-                            }
-                        } else {
-                            decoded_char += sprintf("%c", character);
-                        }
-                    }
-                    new_out += decoded_char;
-                } else {
-                    new_out += out[i..i];
-                }
+
+            if(i >= sz)
+                json_decode_parse_error(pieces, i, "Unexpected end of data");
+
+            if(pieces[i] == ",") {
                 i++;
+                break;
             }
-            out = new_out;
+
+            if(pieces[i] != (frame[JSON_FRAME_KIND] == '{' ? "}" : "]"))
+                json_decode_parse_error(pieces, i, "Unexpected character");
+
+            if(frame[JSON_FRAME_KIND] == '{')
+                value = frame[JSON_FRAME_VALUE];
+            else
+                value = frame[JSON_FRAME_VALUE][0..frame[JSON_FRAME_COUNT]-1];
+
+            stack = stack[0..<2];
+            value_at = i++;
         }
-        if(member_array('/', out) != -1)
-            out = replace_string(out, "\\/", "/");
-        if(member_array('\\', out) != -1)
-            out = replace_string(out, "\\\\", "\\");
     }
-    return out;
 }
 
 /**
- * @function json_decode_parse_number
- * @description Parses a JSON number from the given parse state.
- * @param {mixed[]} parse - The parse state array.
- * @returns {mixed} - The parsed JSON number.
+ * @function json_encode_char
+ * @description Returns the escape sequence for a character that cannot
+ *              appear as-is in a JSON string.
+ * @param {string} ch - The character to escape.
+ * @returns {string} - Its escaped form.
  */
-private mixed json_decode_parse_number(mixed* parse) {
-    int from = parse[JSON_DECODE_PARSE_POS];
-    int to = -1;
-    int dot = -1;
-    int exp = -1;
-    int ch;
-    int next_ch;
-    string number;
-
-    ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-    if(ch == '-') {
-        next_ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS] + 1];
-        if(!next_ch) json_decode_parse_error(parse, "Unexpected end of data");
-        if(next_ch < '0' || next_ch > '9')
-            json_decode_parse_error(parse, "Unexpected character", next_ch);
-        json_decode_parse_next_char(parse);
+private string json_encode_char(string ch) {
+    string out = json_escapes[ch];
+    buffer utf8_buf;
+    int codepoint;
+
+    if(out)
+        return out;
+
+    switch(ch) {
+    case "\""   : out = "\\\""; break;
+    case "\\"   : out = "\\\\"; break;
+    case "\b"   : out = "\\b"; break;
+    case "\x0c" : out = "\\f"; break;
+    case "\n"   : out = "\\n"; break;
+    case "\r"   : out = "\\r"; break;
+    case "\t"   : out = "\\t"; break;
     }
 
-    ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-    if(ch == '0') {
-        // 0 can only either be an direct int value 0, or 0e or 0E
-        next_ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS] + 1];
-        // 0 before EOF
-        if(next_ch == 0) {
-          json_decode_parse_next_char(parse);
-          return 0;
+    if(!out) {
+        utf8_buf = string_encode(ch, "UTF-8");
+
+        // Get the codepoint from the UTF-8 bytes
+        if(sizeof(utf8_buf) == 1) {
+            codepoint = utf8_buf[0];
+        } else if(sizeof(utf8_buf) == 2) {
+            codepoint = ((utf8_buf[0] & 0x1F) << 6) | (utf8_buf[1] & 0x3F);
+        } else if(sizeof(utf8_buf) == 3) {
+            codepoint = ((utf8_buf[0] & 0x0F) << 12) | ((utf8_buf[1] & 0x3F) << 6) | (utf8_buf[2] & 0x3F);
+        } else if(sizeof(utf8_buf) == 4) {
+            codepoint = ((utf8_buf[0] & 0x07) << 18) | ((utf8_buf[1] & 0x3F) << 12) |
+                        ((utf8_buf[2] & 0x3F) << 6) | (utf8_buf[3] & 0x3F);
         }
-        // only valid char here are .eE, continue parse
-        if(next_ch == '.' || next_ch == 'e' || next_ch == 'E') {
-          json_decode_parse_next_char(parse);
+
+        if(codepoint <= 0xFFFF) {
+            out = sprintf("\\u%04X", codepoint);
         } else {
-          // consume until next non-whitespace
-          json_decode_skip_whitespaces(parse);
-          next_ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-          // cannot continue to be number.
-          if((next_ch >= '0' && next_ch <= '9') || next_ch == '-') json_decode_parse_error(parse, "Unexpected character", next_ch);
-          return 0;
-        }
-    }
-    while(to == -1) {
-        ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-        switch(ch) {
-        case '.'        :
-            if(dot != -1 || exp != -1)
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            dot = parse[JSON_DECODE_PARSE_POS];
-            json_decode_parse_next_char(parse);
-            break;
-        case '0'        :
-        case '1'        :
-        case '2'        :
-        case '3'        :
-        case '4'        :
-        case '5'        :
-        case '6'        :
-        case '7'        :
-        case '8'        :
-        case '9'        :
-            json_decode_parse_next_char(parse);
-            break;
-        case 'e'        :
-        case 'E'        :
-            if(exp != -1)
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            exp = parse[JSON_DECODE_PARSE_POS];
-            json_decode_parse_next_char(parse);
-            break;
-        case '-'        :
-        case '+'        :
-            if(exp == parse[JSON_DECODE_PARSE_POS] - 1) {
-                json_decode_parse_next_char(parse);
-                break;
-            }
-            // Fallthrough
-        default         :
-            to = parse[JSON_DECODE_PARSE_POS] - 1;
-            if(dot == to || to < from)
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            break;
+            // Encode as surrogate pair
+            int high = 0xD800 + ((codepoint - 0x10000) >> 10);
+            int low = 0xDC00 + ((codepoint - 0x10000) & 0x3FF);
+            out = sprintf("\\u%04X\\u%04X", high, low);
         }
     }
-    number = string_decode(parse[JSON_DECODE_PARSE_TEXT][from .. to], "utf-8");
-    if(dot != -1 || exp != -1)
-        return to_float(number);
-    else
-        return to_int(number);
-}
 
-/**
- * @function json_decode_parse_value
- * @description Parses a JSON value from the given parse state.
- * @param {mixed[]} parse - The parse state array.
- * @returns {mixed} - The parsed JSON value.
- */
-private mixed json_decode_parse_value(mixed* parse) {
-    for(;;) {
-        int ch;
-        ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-        switch(ch) {
-        case 0          :
-            json_decode_parse_error(parse, "Unexpected end of data");
-        case '{'        :
-            return json_decode_parse_object(parse);
-        case '['        :
-            return json_decode_parse_array(parse);
-        case '"'        :
-            return json_decode_parse_string(parse, 1);
-        case '-'        :
-        case '0'        :
-        case '1'        :
-        case '2'        :
-        case '3'        :
-        case '4'        :
-        case '5'        :
-        case '6'        :
-        case '7'        :
-        case '8'        :
-        case '9'        :
-            return json_decode_parse_number(parse);
-        case ' '        :
-        case '\t'       :
-        case '\r'       :
-            json_decode_parse_next_char(parse);
-            break;
-        case 0x0c       :
-        case '\n'       :
-            json_decode_parse_next_line(parse);
-            break;
-        case 't'        :
-            if(json_decode_parse_at_token(parse, "true", 1)) {
-                json_decode_parse_next_chars(parse, 4);
-                return 1;
-            } else {
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            }
-        case 'f'        :
-            if(json_decode_parse_at_token(parse, "false", 1)) {
-                json_decode_parse_next_chars(parse, 5);
-                return 0;
-            } else {
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            }
-        case 'n'        :
-            if(json_decode_parse_at_token(parse, "null", 1)) {
-                json_decode_parse_next_chars(parse, 4);
-                return ([])[0] ; // undefined
-            } else {
-                json_decode_parse_error(parse, "Unexpected character", ch);
-            }
-        default         :
-            json_decode_parse_error(parse, "Unexpected character", ch);
-        }
-    }
+    if(sizeof(json_escapes) >= JSON_CACHE_MAX)
+        json_escapes = ([ ]);
+
+    return json_escapes[ch] = out;
 }
 
 /**
- * @function json_decode_parse
- * @description Parses a JSON value from the given parse state.
- * @param {mixed[]} parse - The parse state array.
- * @returns {mixed} - The parsed JSON value.
+ * @function json_encode_string
+ * @description Serializes a string, escaping only when it has to.
+ * @param {string} str - The string to serialize.
+ * @returns {string} - The quoted JSON string.
  */
-private mixed json_decode_parse(mixed* parse) {
-    mixed out = json_decode_parse_value(parse);
-    for(;;) {
-        int ch = parse[JSON_DECODE_PARSE_TEXT][parse[JSON_DECODE_PARSE_POS]];
-        switch(ch) {
-        case 0          :
-            return out;
-        case ' '        :
-        case '\t'       :
-        case '\r'       :
-            json_decode_parse_next_char(parse);
-            break;
-        case 0x0c       :
-        case '\n'       :
-            json_decode_parse_next_line(parse);
-            break;
-        default         :
-            json_decode_parse_error(parse, "Unexpected character", ch);
-        }
-    }
-    return 0;
+private string json_encode_string(string str) {
+    mixed *assoc;
+    string *pieces;
+    int *ids;
+    int i;
+
+    if(!pcre_match(str, json_escape_pattern))
+        return "\"" + str + "\"";
+
+    assoc = pcre_assoc(str, ({ json_escape_pattern }), ({ 1 }), 0);
+    pieces = assoc[0];
+    ids = assoc[1];
+
+    for(i = sizeof(pieces); i--;)
+        if(ids[i])
+            pieces[i] = json_encode_char(pieces[i]);
+
+    return "\"" + implode(pieces, "") + "\"";
 }
 
 /**
- * @simul_efun json_decode
- * @description Deserializes a JSON string into an LPC value.
- * @param {string} text - The JSON string to deserialize.
- * @returns {mixed} - The deserialized LPC value.
+ * @function json_encode_key
+ * @description Serializes a mapping key followed by its colon. Keys repeat
+ *              far more than values, so their encodings are kept.
+ * @param {string} key - The key to serialize.
+ * @returns {string} - The quoted key and colon.
  */
-mixed json_decode(string text) {
-    mixed* parse;
-    buffer endl = allocate_buffer(1);
-    endl[0] = 0;
+private string json_encode_key(string key) {
+    string out = json_keys[key];
 
-    if(!text) {
-      return 0;
-    }
+    if(out)
+        return out;
 
-    parse = allocate(JSON_DECODE_PARSE_FIELDS);
-    parse[JSON_DECODE_PARSE_TEXT] = string_encode(text, "utf-8") + endl;
-    parse[JSON_DECODE_PARSE_POS] = 0;
-    parse[JSON_DECODE_PARSE_CHAR] = 1;
-    parse[JSON_DECODE_PARSE_LINE] = 1;
-    return json_decode_parse(parse);
-}
+    if(sizeof(json_keys) >= JSON_CACHE_MAX)
+        json_keys = ([ ]);
 
-private nosave nomask string unicode_pattern = "([\\x{80}-\\x{10FFFF}])";
+    return json_keys[key] = json_encode_string(key) + ":";
+}
 
 /**
  * @simul_efun json_encode
@@ -662,119 +435,70 @@ private nosave nomask string unicode_pattern = "([\\x{80}-\\x{10FFFF}])";
  * @returns {string} - The JSON string representation of the LPC value.
  */
 varargs string json_encode(mixed value, mixed* pointers) {
-
+    string *parts;
+    int ix, nested;
 
     if(undefinedp(value))
         return "null";
     if(intp(value) || floatp(value))
         return to_string(value);
-    if(stringp(value)) {
-        if(member_array('"', value) != -1)
-            value = replace_string(value, "\"", "\\\"");
-        value = sprintf("\"%s\"", value);
-        if(member_array('\\', value) != -1) {
-            value = replace_string(value, "\\", "\\\\");
-            if(strsrch(value, "\\\"") != -1)
-                value = replace_string(value, "\\\"", "\"");
-        }
-        if(member_array('\b', value) != -1)
-            value = replace_string(value, "\b", "\\b");
-        if(member_array(0x0c, value) != -1)
-            value = replace_string(value, "\x0c", "\\f");
-        if(member_array('\n', value) != -1)
-            value = replace_string(value, "\n", "\\n");
-        if(member_array('\r', value) != -1)
-            value = replace_string(value, "\r", "\\r");
-        if(member_array('\t', value) != -1)
-            value = replace_string(value, "\t", "\\t");
-        if(member_array(0x1b, value) != -1)
-          value = replace_string(value, "\x1b", "\\u001b");
-
-        // Unicode handling
-        while(pcre_match(value, unicode_pattern)) {
-            int codepoint;
-            string char_to_replace = pcre_extract(value, unicode_pattern)[0];
-            buffer utf8_buf = string_encode(char_to_replace, "UTF-8");
-
-            // Get the codepoint from the UTF-8 bytes
-            if(sizeof(utf8_buf) == 1) {
-                codepoint = utf8_buf[0];
-            } else if(sizeof(utf8_buf) == 2) {
-                codepoint = ((utf8_buf[0] & 0x1F) << 6) | (utf8_buf[1] & 0x3F);
-            } else if(sizeof(utf8_buf) == 3) {
-                codepoint = ((utf8_buf[0] & 0x0F) << 12) | ((utf8_buf[1] & 0x3F) << 6) | (utf8_buf[2] & 0x3F);
-            } else if(sizeof(utf8_buf) == 4) {
-                codepoint = ((utf8_buf[0] & 0x07) << 18) | ((utf8_buf[1] & 0x3F) << 12) |
-                            ((utf8_buf[2] & 0x3F) << 6) | (utf8_buf[3] & 0x3F);
-            }
-
-            if(codepoint <= 0xFFFF) {
-                value = pcre_replace(value, unicode_pattern, ({ sprintf("\\u%04X", codepoint) }));
-            } else {
-                // Encode as surrogate pair
-                int high = 0xD800 + ((codepoint - 0x10000) >> 10);
-                int low = 0xDC00 + ((codepoint - 0x10000) & 0x3FF);
-                value = pcre_replace(value, unicode_pattern, ({ sprintf("\\u%04X\\u%04X", high, low) }));
-            }
-        }
+    if(stringp(value))
+        return json_encode_string(value);
 
-        return value;
+    if(!mapp(value) && !pointerp(value)) {
+        // Values that cannot be represented in JSON are replaced by nulls.
+        return "null";
     }
 
+    if(!sizeof(value))
+        return mapp(value) ? "{}" : "[]";
+
+    // Don't recurse into circular data structures, output null for their
+    // interior reference
+    if(pointers && member_array(value, pointers) != -1)
+        return "null";
+
+    // Strings and numbers are written directly; only nested values go back
+    // through json_encode, so flat mappings and arrays never recurse.
+    parts = allocate(sizeof(value));
+
     if(mapp(value)) {
-        string out;
-        int ix = 0;
-        if(pointers) {
-            // Don't recurse into circular data structures, output null for
-            // their interior reference
-            if(member_array(value, pointers) != -1)
-                return "null";
-            pointers += ({ value });
-        } else {
-            pointers = ({ value });
-        }
         foreach(mixed k, mixed v in value) {
             // Non-string keys are skipped because the JSON spec requires that
             // object field names be strings.
             if(!stringp(k))
                 continue;
-            if(ix++)
-                out = sprintf("%s,%s:%s", out, json_encode(k, pointers), json_encode(v, pointers));
-            else
-                out = sprintf("%s:%s", json_encode(k, pointers), json_encode(v, pointers));
+
+            if(stringp(v)) {
+                parts[ix++] = json_encode_key(k) + json_encode_string(v);
+            } else if(floatp(v) || (intp(v) && !undefinedp(v))) {
+                parts[ix++] = json_encode_key(k) + to_string(v);
+            } else {
+                if(!nested++)
+                    pointers = (pointers || ({ })) + ({ value });
+                parts[ix++] = json_encode_key(k) + json_encode(v, pointers);
+            }
         }
-        if(!out || out == "")
+
+        if(!ix)
             return "{}";
-        return sprintf("{%s}", out);
+
+        return "{" + implode(ix < sizeof(parts) ? parts[0..ix-1] : parts, ",") + "}";
     }
-    if(pointerp(value)) {
-        if(sizeof(value)) {
-            string out;
-            int ix = 0;
-            if(pointers) {
-                // Don't recurse into circular data structures, output null for
-                // their interior reference
-                if(member_array(value, pointers) != -1)
-                    return "null";
-                pointers += ({ value });
-            } else {
-                pointers = ({ value });
-            }
-            foreach(mixed v in value)
-                if(ix++)
-                    out = sprintf("%s,%s", out, json_encode(v, pointers));
-                else
-                    out = json_encode(v, pointers);
-
-            if(!out || out == "")
-                return "[]";
-            return sprintf("[%s]", out);
+
+    foreach(mixed v in value) {
+        if(stringp(v)) {
+            parts[ix++] = json_encode_string(v);
+        } else if(floatp(v) || (intp(v) && !undefinedp(v))) {
+            parts[ix++] = to_string(v);
         } else {
-            return "[]";
+            if(!nested++)
+                pointers = (pointers || ({ })) + ({ value });
+            parts[ix++] = json_encode(v, pointers);
         }
     }
-    // Values that cannot be represented in JSON are replaced by nulls.
-    return "null";
+
+    return "[" + implode(parts, ",") + "]";
 }
 
 #endif /* __STD_JSON_H */
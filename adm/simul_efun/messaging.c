@@ -1,5 +1,69 @@
 #include <simul_efun.h>
 
+// Renders shared by every recipient of the broadcast in progress, keyed by
+// client profile and then by message.
+private nosave mapping _broadcast_renders = ([ ]);
+private nosave int _broadcast_depth = 0;
+
+/**
+ * Opens a broadcast scope. While one is open, recipients with the same
+ * client profile share a single rendering of each message. Scopes may nest;
+ * the shared renders are discarded when the outermost one closes.
+ */
+void begin_broadcast() {
+  _broadcast_depth++;
+}
+
+/**
+ * Closes a broadcast scope opened with begin_broadcast().
+ */
+void end_broadcast() {
+  if(_broadcast_depth > 0)
+    _broadcast_depth--;
+
+  if(!_broadcast_depth)
+    _broadcast_renders = ([ ]);
+}
+
+/**
+ * Returns the rendering of a message already produced for a client profile
+ * during the current broadcast.
+ *
+ * @param {string} message - The unrendered message
+ * @param {string} profile - The recipient's client profile
+ * @returns {string} The rendered message, or 0 if none is available
+ */
+string query_broadcast_render(string message, string profile) {
+  mapping renders;
+
+  if(!_broadcast_depth)
+    return 0;
+
+  if(!mapp(renders = _broadcast_renders[profile]))
+    return 0;
+
+  return renders[message];
+}
+
+/**
+ * Records the rendering of a message for a client profile so that other
+ * recipients of the current broadcast can reuse it. Does nothing outside of
+ * a broadcast.
+ *
+ * @param {string} message - The unrendered message
+ * @param {string} profile - The recipient's client profile
+ * @param {string} rendered - The rendered message
+ */
+void set_broadcast_render(string message, string profile, string rendered) {
+  if(!_broadcast_depth)
+    return;
+
+  if(!mapp(_broadcast_renders[profile]))
+    _broadcast_renders[profile] = ([ ]);
+
+  _broadcast_renders[profile][message] = rendered;
+}
+
 /**
  * Sends a message upward through the containment hierarchy, such as from an
  * object to its container, and further up to the room or environment.
@@ -23,7 +87,14 @@ varargs void tell_up(object ob, string str, int msg_type, mixed exclude) {
  * @param {mixed} [exclude] - The objects to exclude from receiving the message.
  */
 varargs void tell_down(object ob, string str, int msg_type, mixed exclude) {
-  ob->receive_down(str, exclude, msg_type | DOWN_MSG);
+  string e;
+
+  begin_broadcast();
+  e = catch(ob->receive_down(str, exclude, msg_type | DOWN_MSG));
+  end_broadcast();
+
+  if(e)
+    error(e);
 }
 
 /**
@@ -36,7 +107,14 @@ varargs void tell_down(object ob, string str, int msg_type, mixed exclude) {
  * @param {mixed} [exclude] - The objects to exclude from receiving the message.
  */
 varargs void tell_all(object ob, string str, int msg_type, mixed exclude) {
-  ob->receive_all(str, exclude, msg_type | ALL_MSG);
+  string e;
+
+  begin_broadcast();
+  e = catch(ob->receive_all(str, exclude, msg_type | ALL_MSG));
+  end_broadcast();
+
+  if(e)
+    error(e);
 }
 
 /**
@@ -357,9 +357,16 @@ object *all_environment(object ob) {
  * @returns {object*} An array of living objects present in the room.
  */
 object *present_livings(object room) {
+  object *obs;
+
   if(!room)
     return ({});
 
+  // Containers keep an index of the livings inside them.
+  obs = room->query_present_livings();
+  if(pointerp(obs))
+    return obs;
+
   return filter(all_inventory(room), (: living($1) :));
 }
 
@@ -370,9 +377,15 @@ object *present_livings(object room) {
  * @returns {object STD_PLAYER*} An array of player objects present in the room.
  */
 object *present_players(object room) {
+  object *obs;
+
   if(!room)
     return ({});
 
+  obs = room->query_present_players();
+  if(pointerp(obs))
+    return obs;
+
   return filter(present_livings(room), (: userp :));
 }
 
@@ -646,6 +659,47 @@ varargs object *find_targets(object user, string arg, object source, function f)
   return obs;
 }
 
+/**
+ * Like find_targets(), but only considers the livings in the container, so
+ * that rooms full of items do not have to be scanned when looking for
+ * someone.
+ *
+ * @param {object STD_PLAYER | object STD_NPC} user - The body object of the player or NPC searching
+ * @param {string} arg - The argument to match livings against
+ * @param {object} source - The object to search within. If not provided, the
+ *                          environment of the calling object will be used.
+ * @param {function} f - An optional custom filter function to further filter
+ *                       the livings.
+ * @returns {object*} An array of located livings or 0 if none are found.
+ */
+varargs object *find_living_targets(object user, string arg, object source, function f) {
+  object *obs;
+  object env;
+
+  if(nullp(user))
+    error("Missing argument 1 for find_living_targets");
+
+  if(objectp(source))
+    env = source;
+  else
+    env = environment(user);
+
+  if(!env)
+    return 0;
+
+  obs = present_livings(env);
+
+  if(arg)
+    obs = filter_by_id(obs, arg);
+
+  obs = filter_by_visibility(user, obs);
+
+  if(valid_function(f))
+    obs = apply_custom_filter(obs, f, user);
+
+  return obs;
+}
+
 /**
  * This simul_efun will find a single object in a container, such as a room,
  * chest, player's inventory, that matches the specified argument. The
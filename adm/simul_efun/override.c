@@ -30,6 +30,8 @@ void shutdown(int how) {
 
   emit(SIG_SYS_SHUTDOWN);
   PERSIST_D->persist_objects();
+  // Logs are buffered, so write out everything logged on the way down.
+  master()->flush_logs();
   efun::shutdown(how);
 }
 
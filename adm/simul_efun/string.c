@@ -152,8 +152,154 @@ varargs string substr(string str, string sub, int reverse) {
         return str[0..pos-1];
 }
 
-// This simul_efun blatantly (but lovingly) ripped off from:
+// from_string originally came from Dead Souls:
 // https://github.com/fluffos/dead-souls/blob/09a74caa87d8aadbfe303c294cc0bebb25fdb4db/lib/secure/sefun/strings.c#L104C1-L242C1
+//
+// It now walks the string once with a single cursor, keeping open arrays
+// and mappings on a stack instead of recursing on cut-down copies of the
+// rest of the string.
+
+// Parser frame layout
+#define FS_KIND    0
+#define FS_VALUE   1
+#define FS_COUNT   2
+#define FS_KEY     3
+#define FS_HAS_KEY 4
+
+#define FS_ARRAY   0
+#define FS_MAPPING 1
+
+private int fs_skip_blank(string str, int pos, int len) {
+    while(pos < len) {
+        int c = str[pos];
+
+        if(c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            break;
+
+        pos++;
+    }
+
+    return pos;
+}
+
+// Returns the position just past a container's closing bracket and
+// parenthesis, or -1 if the container is not closed at pos.
+private int fs_close_at(mixed *frame, string str, int pos, int len) {
+    int closer = frame[FS_KIND] == FS_ARRAY ? '}' : ']';
+
+    if(pos >= len || str[pos] != closer)
+        return -1;
+
+    pos = fs_skip_blank(str, pos + 1, len);
+    if(pos >= len || str[pos] != ')')
+        error("Illegal " + (closer == '}' ? "array" : "mapping") + " terminator.\n");
+
+    return pos + 1;
+}
+
+// Reads a quoted string starting at the opening quote. Returns the string
+// and the position just past the closing quote.
+private mixed *fs_read_string(string str, int pos, int len) {
+    string *pieces = ({ });
+    int start = ++pos;
+
+    while(pos < len) {
+        int c = str[pos];
+
+        if(c == '"')
+            return ({ implode(pieces + ({ str[start..pos-1] }), ""), pos + 1 });
+
+        if(c == '\\') {
+            if(pos + 1 >= len)
+                break;
+
+            pieces += ({ str[start..pos-1] });
+
+            switch(str[pos+1]) {
+                case 'n': pieces += ({ "\n" }); break;
+                case 't': pieces += ({ "\t" }); break;
+                case 'r': pieces += ({ "\r" }); break;
+                default: pieces += ({ str[pos+1..pos+1] }); break;
+            }
+
+            pos += 2;
+            start = pos;
+            continue;
+        }
+
+        // A string broken across lines is joined back together without the
+        // indentation around the break.
+        if(c == '\n') {
+            pieces += ({ rtrim(str[start..pos-1]) });
+            pos = fs_skip_blank(str, pos, len);
+            start = pos;
+            continue;
+        }
+
+        pos++;
+    }
+
+    error("Unterminated string.\n");
+}
+
+// Reads a decimal, float or hexadecimal number. Returns the number and the
+// position just past it.
+private mixed *fs_read_number(string str, int pos, int len) {
+    int start = pos, negative, is_float, value, c;
+
+    if(str[pos] == '-') {
+        negative = 1;
+        pos++;
+    }
+
+    if(pos + 1 < len && str[pos] == '0' && (str[pos+1] == 'x' || str[pos+1] == 'X')) {
+        int digits;
+
+        pos += 2;
+        digits = pos;
+
+        while(pos < len) {
+            c = str[pos];
+            if(!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+                break;
+            pos++;
+        }
+
+        if(pos == digits)
+            error("Improperly formatted number: " + str[start..] + "\n");
+
+        sscanf(str[digits..pos-1], "%x", value);
+
+        return ({ negative ? -value : value, pos });
+    }
+
+    while(pos < len) {
+        c = str[pos];
+
+        if(c >= '0' && c <= '9') {
+            pos++;
+        } else if(c == '.' && !is_float) {
+            is_float = 1;
+            pos++;
+        } else if((c == 'e' || c == 'E') && pos > start) {
+            is_float = 1;
+            pos++;
+            if(pos < len && (str[pos] == '-' || str[pos] == '+'))
+                pos++;
+        } else {
+            break;
+        }
+    }
+
+    if(pos == start + negative)
+        error("Improperly formatted number: " + str[start..] + "\n");
+
+    if(is_float)
+        return ({ to_float(str[start..pos-1]), pos });
+
+    return ({ to_int(str[start..pos-1]), pos });
+}
+
 /**
  * @simul_efun from_string
  * @description Converts a string representation of an LPC value to the
@@ -164,191 +310,117 @@ varargs string substr(string str, string sub, int reverse) {
  * @returns {mixed} - The LPC value represented by the string.
  */
 varargs mixed from_string(string str, int flag) {
-    mixed *ret = ({ 0, "" });
+    mixed *stack = ({ }), *frame, *read;
+    mixed value;
+    int pos, len, next, c;
 
-    if(!str || !sizeof(str) || str == "")
+    if(!stringp(str))
         return 0;
 
-    if((str = trim(str)) == "")
+    len = strlen(str);
+    pos = fs_skip_blank(str, 0, len);
+    if(pos >= len)
         return 0;
 
-    str = implode(map(explode(str, "\n"), function(string line) {
-        return trim(line);
-    }), "\n");
-
-    str = replace_string(str, "\n", "");
-    str = replace_string(str, "\"\"", "");
-
-    if(str[0] == '(') {
-        switch(str[1]) {
-            case '{':
-                ret[0] = ({});
-                str = ltrim(str[2..]);
-                if(str[0] == '}') {
-                    // Empty array case
-                    str = str[1..];
-                    str = ltrim(str);
-                    if(str[0] != ')')
-                        error("Illegal array terminator.\n");
-                    ret[1] = str[1..];
-                    return flag ? ret : ret[0];
-                }
-                while(str[0] != '}') {
-                    mixed *tmp;
-
-                    tmp = from_string(str, 1);
-                    ret[0] += ({ tmp[0] });
-                    str = tmp[1];
-                    while(str[0] == ' ' || str[0] == '\t')
-                        str = str[1..];
-                    if(str[0] != ',' && str[0] != '}') {
-                        error("Improperly formatted array: " + str + "\n");
-                    } else if(str[0] == ',') {
-                        str = str[1..];
-                        while(str[0] == ' ' || str[0] == '\t')
-                            str = str[1..];
-                    }
-                }
+    while(1) {
+        pos = fs_skip_blank(str, pos, len);
 
-                if(str[1] != ')') {
-                    str = str[2..];
-                    while(str[0] == ' ' || str[0] == '\t')
-                        str = str[1..];
-                    if(str[0] != ')')
-                        error("Illegal array terminator.\n");
-                    else
-                        ret[1] = str[1..];
-                }
-                else
-                    ret[1] = str[2..];
-
-                if(!flag)
-                    return ret[0];
-
-                while(ret[1][0] == ' ' || ret[1][0] == '\t')
-                    ret[1] = ret[1][1..];
-
-                return ret;
-            case '[':
-                ret[0] = ([]);
-                str = str[2..];
-                while(str[0] != ']') {
-                    mixed *tmp;
-                    mixed cle;
-
-                    tmp = from_string(str, 1);
-                    str = tmp[1];
-                    while(str[0] == ' ' || str[0] == '\t') str = str[1..];
-                    if(str[0] != ':')
-                        error("Illegally formatting mapping: " + str + "\n");
-                    cle = tmp[0];
-                    tmp = from_string(str[1..], 1);
-                    ret[0][cle] = tmp[0];
-                    str = tmp[1];
-                    while(str[0] == ' ' || str[0] == '\t')
-                        str = str[1..];
-                    if(str[0] != ',' && str[0] != ']')
-                        error("Illegally formatted mapping: " + str + "n");
-                    else if(str[0] != ']') {
-                        str = str[1..];
-                        while(str[0] == ' ' || str[0] == '\t') str = str[1..];
-                    }
-                }
-                if(str[1] != ')') {
-                    str = str[2..];
-                    while(str[0] == ' ' || str[0] == '\t')
-                        str = str[1..];
-                    if(str[0] != ')')
-                        error("Illegal array terminator.\n");
-                    else
-                        ret[1] = str[1..];
-                }
-                else
-                    ret[1] = str[2..];
-                if(!flag)
-                    return ret[0];
-                while(ret[1][0] == ' ' || ret[1][0] == '\t')
-                    ret[1] = ret[1][1..];
-                return ret;
-        }
-    } else if(str[0] == '"') {
-        string tmp;
+        // Either close the innermost container, open a new one, or read a
+        // single value.
+        if(sizeof(stack) && (next = fs_close_at(stack[<1], str, pos, len)) != -1) {
+            frame = stack[<1];
+            if(frame[FS_HAS_KEY])
+                error("Illegally formatted mapping: missing value.\n");
 
-        tmp = "";
-        while(str[1] != '"' || (str[1] == '"' && str[0] == '\\')) {
-            if(str[1] == '"')
-                tmp = tmp[0..<2] + "\"";
+            if(frame[FS_KIND] == FS_ARRAY)
+                value = frame[FS_COUNT] ? frame[FS_VALUE][0..frame[FS_COUNT]-1] : ({ });
             else
-                tmp += str[1..1];
-            str = str[1..];
-        }
-        if(!flag)
-            return tmp;
-        if(strlen(str) > 2)
-            str = trim(str[2..]);
-        return ({ tmp, str });
-    } else if(str[0] >= '0' && str[0] <= '9' || str[0] == '-') {
-        string tmp;
-        int y;
-
-        if(strlen(str) > 1 && str[0] == '-') {
-            tmp = str[0..0];
-            str = str[1..];
+                value = frame[FS_VALUE];
+
+            stack = stack[0..<2];
+            pos = next;
         } else {
-            tmp = "";
-        }
+            if(pos >= len)
+                error("Unexpected end of string.\n");
+
+            c = str[pos];
+
+            if(c == '(' && pos + 1 < len && (str[pos+1] == '{' || str[pos+1] == '[')) {
+                if(str[pos+1] == '{')
+                    stack += ({ ({ FS_ARRAY, allocate(8), 0, 0, 0 }) });
+                else
+                    stack += ({ ({ FS_MAPPING, ([ ]), 0, 0, 0 }) });
 
-        if(strlen(str) > 1 && str[0..1] == "0x") {
-            tmp = "0x";
-            str = str[2..];
-            while(str != "" && (str[0] >= '0' && str[0] <= '9')) {
-                tmp += str[0..0];
-                if(strlen(str) > 1) str = str[1..];
-                else str = "";
+                pos += 2;
+                continue;
             }
-            sscanf(tmp, "%x", y);
-        } else {
-            int decimal_found = 0;
-            while(str != "" && (str[0] == '.' || (str[0] >= '0' && str[0] <= '9'))) {
-                if(str[0] == '.') {
-                    if(decimal_found)
-                        error("Improperly formatted number: " + str + "\n");
-                    decimal_found = 1;
+
+            if(c == '"') {
+                read = fs_read_string(str, pos, len);
+            } else if((c >= '0' && c <= '9') || c == '-') {
+                read = fs_read_number(str, pos, len);
+            } else {
+                next = pos;
+                while(next < len) {
+                    c = str[next];
+                    if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                         (c >= '0' && c <= '9') || c == '_'))
+                        break;
+                    next++;
                 }
 
-                tmp += str[0..0];
-                if(strlen(str) > 1) str = str[1..];
-                else str = "";
+                if(next == pos)
+                    error("Gobbledygook in string.\n");
+
+                read = ({ get_object(str[pos..next-1]), next });
             }
-            if(decimal_found)
-                sscanf(tmp, "%f", y);
-            else
-                sscanf(tmp, "%d", y);
+
+            value = read[0];
+            pos = read[1];
         }
-        if(!flag)
-            return y;
-        if(str != "")
-            str = trim(str);
-        return ({ y, str });
-    } else {
-        string tmp;
-
-        tmp = "";
-        while(strlen(str) && ((str[0] >= 'a' && str[0] <= 'z') ||
-                (str[0] >= 'A' && str[0] <= 'Z') ||
-                (str[0] >= '0' && str[0] <= '9') ||
-                (str[0] == '_'))) {
-            tmp += str[0..0];
-            if(strlen(str) > 1)
-                str = str[1..];
-            else str = "";
+
+        if(!sizeof(stack))
+            break;
+
+        // Hand the value to the container it belongs to.
+        frame = stack[<1];
+        pos = fs_skip_blank(str, pos, len);
+
+        if(frame[FS_KIND] == FS_MAPPING) {
+            if(!frame[FS_HAS_KEY]) {
+                if(pos >= len || str[pos] != ':')
+                    error("Illegally formatted mapping: " + str[pos..] + "\n");
+
+                frame[FS_KEY] = value;
+                frame[FS_HAS_KEY] = 1;
+                pos++;
+                continue;
+            }
+
+            frame[FS_VALUE][frame[FS_KEY]] = value;
+            frame[FS_HAS_KEY] = 0;
+        } else {
+            if(frame[FS_COUNT] == sizeof(frame[FS_VALUE]))
+                frame[FS_VALUE] += allocate(frame[FS_COUNT]);
+
+            frame[FS_VALUE][frame[FS_COUNT]++] = value;
         }
-        if(!flag)
-            return get_object(tmp);
-        else
-        return ({ get_object(tmp), str });
+
+        if(pos < len && str[pos] == ',') {
+            pos++;
+            continue;
+        }
+
+        if(fs_close_at(frame, str, pos, len) == -1)
+            error("Improperly formatted " +
+                (frame[FS_KIND] == FS_ARRAY ? "array" : "mapping") + ": " +
+                str[pos..] + "\n");
     }
-    error("Gobbledygook in string.\n");
+
+    if(!flag)
+        return value;
+
+    return ({ value, pos < len ? trim(str[pos..]) : "" });
 }
 
 /**
@@ -115,14 +115,52 @@ string arch() {
   return __ARCH__;
 }
 
+private nosave mapping _config_snapshot;
+private nosave int _config_slotted;
+
+/**
+ * Drops the cached configuration snapshot so that the next mud_config()
+ * call fetches the current one. Slotted to SIG_SYS_CONFIG_CHANGED.
+ */
+void invalidate_config_snapshot() {
+  _config_snapshot = 0;
+}
+
 /**
  * Retrieves a specific configuration value from the MUD config.
  *
+ * Values are read from a snapshot of CONFIG_D's merged configuration, which
+ * is refreshed when the configuration is rehashed.
+ *
  * @param {string} str - The configuration key to retrieve.
  * @returns {mixed} The configuration value.
+ * @errors If the key is missing or unknown.
  */
 mixed mud_config(string str) {
-  return CONFIG_D->get_mud_config(str);
+  mixed value;
+
+  if(!mapp(_config_snapshot)) {
+    _config_snapshot = CONFIG_D->get_config_snapshot();
+
+    if(!mapp(_config_snapshot))
+      error("get_mud_config: No configuration found.");
+  }
+
+  // The signal daemon itself needs configuration to load, so only listen
+  // for changes once it is up.
+  if(!_config_slotted && find_object(SIGNAL_D))
+    _config_slotted = SIGNAL_D->register_slot(
+      SIG_SYS_CONFIG_CHANGED, this_object(), "invalidate_config_snapshot"
+    ) == SIG_SLOT_OK;
+
+  if(!str)
+    error("get_mud_config: Missing key.");
+
+  value = _config_snapshot[str];
+  if(nullp(value))
+    error("get_mud_config: Invalid key: " + str + ".");
+
+  return value;
 }
 
 /**
@@ -137,7 +137,7 @@ mixed render_room(object tp, object room, int brief) {
   if(data)
     result += data;
 
-  users = find_targets(tp, null, room, (: living($1) && $1 != $(tp) :));
+  users = find_living_targets(tp, null, room, (: $1 != $(tp) :));
   objects = find_targets(tp, null, room, (: !living($1) :));
 
   if(sizeof(users) > 0) {
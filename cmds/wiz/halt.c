@@ -17,7 +17,7 @@ mixed main(object tp, string arg) {
     if(!arg) {
         who = ({ tp });
     } else if(arg == "all") {
-        who = filter(all_inventory(room), (: living :));
+        who = present_livings(room);
     } else if(arg == "global") {
         who = filter(livings(), (: environment :));
     } else {
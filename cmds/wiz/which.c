@@ -17,11 +17,9 @@ mixed main(object caller, string args) {
     if(!args)
         return notify_fail("Error: Syntax: which <verb/command>\n");
 
-    for(i = 0; i < sizeof(command_path); i ++) {
-        if(file_exists(command_path[i] + args + ".c")) {
-            is_located = 1;
-            tell_me(command_path[i] + args + "\n");
-        }
+    foreach(string cmd in COMMAND_D->resolve_command(command_path, args)) {
+        is_located = 1;
+        tell_me(cmd + "\n");
     }
 
     for(i = 0; i < sizeof(actions); i++) {
@@ -13,6 +13,7 @@
 #define BOOT_D          DIR_DAEMONS "boot"
 #define CHAN_D          DIR_DAEMONS "channel"
 #define COLOUR_D        DIR_DAEMONS "colour"
+#define COMMAND_D       DIR_DAEMONS "command"
 #define CONFIG_D        DIR_DAEMONS "config"
 #define COORD_D         DIR_DAEMONS "coord"
 #define CRASH_D         DIR_DAEMONS "crash"
@@ -35,6 +36,7 @@
 #define MUDDY_D         DIR_DAEMONS "muddy"
 #define PERSIST_D       DIR_DAEMONS "persist"
 #define RECURSE_RMDIR_D DIR_DAEMONS "recurse_rmdir"
+#define SCHEDULER_D     DIR_DAEMONS "scheduler"
 #define SHUTDOWN_D      DIR_DAEMONS "shutdown"
 #define SIGNAL_D        DIR_DAEMONS "signal"
 #define SOUL_D          DIR_DAEMONS "soul_d"
@@ -14,6 +14,8 @@
 #define HTTP_STATUS_FORBIDDEN "403 Forbidden"
 #define HTTP_STATUS_NOT_FOUND "404 Not Found"
 #define HTTP_STATUS_METHOD_NOT_ALLOWED "405 Method Not Allowed"
+#define HTTP_STATUS_PAYLOAD_TOO_LARGE "413 Payload Too Large"
+#define HTTP_STATUS_HEADERS_TOO_LARGE "431 Request Header Fields Too Large"
 #define HTTP_STATUS_INTERNAL_SERVER_ERROR "500 Internal Server Error"
 #define HTTP_STATUS_NOT_IMPLEMENTED "501 Not Implemented"
 #define HTTP_STATUS_BAD_GATEWAY "502 Bad Gateway"
@@ -29,6 +31,14 @@
 #define HTTP_STATE_COMPLETE 7
 #define HTTP_STATE_ERROR 100
 
+// Persistent connections (HTTP server)
+#define HTTP_KEEP_ALIVE_TIMEOUT 15   // idle seconds before a connection is closed
+#define HTTP_KEEP_ALIVE_MAX 100      // requests served on one connection
+#define HTTP_MAX_HEADER_SIZE 16384   // bytes allowed before the blank line
+
+// Static assets (HTTP module)
+#define HTTP_ASSET_CACHE_MAX 8388608 // bytes of file data kept in memory
+
 #define HTTP_REDIRECT_CODES ({ \
     301, 302, 303, 307, 308, \
 })
@@ -37,6 +47,7 @@
 #define CONTENT_TYPE_TEXT_PLAIN "text/plain"
 #define CONTENT_TYPE_TEXT_HTML "text/html"
 #define CONTENT_TYPE_TEXT_CSS "text/css"
+#define CONTENT_TYPE_TEXT_JAVASCRIPT "text/javascript"
 #define CONTENT_TYPE_APPLICATION_JSON "application/json"
 #define CONTENT_TYPE_APPLICATION_XML "application/xml"
 #define CONTENT_TYPE_APPLICATION_FORM_URLENCODED "application/x-www-form-urlencoded"
@@ -44,5 +55,8 @@
 #define CONTENT_TYPE_IMAGE_JPEG "image/jpeg"
 #define CONTENT_TYPE_IMAGE_PNG "image/png"
 #define CONTENT_TYPE_IMAGE_GIF "image/gif"
+#define CONTENT_TYPE_IMAGE_SVG "image/svg+xml"
+#define CONTENT_TYPE_IMAGE_ICON "image/x-icon"
+#define CONTENT_TYPE_APPLICATION_OCTET_STREAM "application/octet-stream"
 
 #endif // HTTP_CONSTANTS_H
@@ -20,6 +20,7 @@
 #define SIG_SYS_REBOOT_CANCEL       106
 #define SIG_SYS_PERSIST             107
 #define SIG_SYS_CRAWL_COMPLETE      108
+#define SIG_SYS_CONFIG_CHANGED      109
 
 // Standard user signals
 #define SIG_USER_LOGIN              200
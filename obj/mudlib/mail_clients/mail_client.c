@@ -8,6 +8,10 @@
 
  Last edited on August 22nd, 2006 by Parthenon
 
+ 2026-10-17 - Gesslar - Mailboxes now only hold headers; message bodies
+ are fetched from MAIL_D when a message is read, replied to, forwarded or
+ saved.
+
 */
 
 /* QC by Tacitus on July 13th, 2006 */
@@ -38,6 +42,7 @@ void get_subject(string arg, int flag, int forward);
 protected varargs void do_save(int flag, int num1, int num2);
 protected void save_mailbox();
 protected mixed save_message(string path, mapping message);
+protected string query_body(mapping header);
 void done_reading();
 void client(object tp);
 
@@ -597,7 +602,7 @@ protected void read_message(int num) {
         ret += "DATE:    " + outbox[num]["DATE"] + "\n";
         ret += "CC:      " + implode(outbox[num]["CC"], ", ") + "\n";
         ret += "_____________________________________________________________________\n";
-        ret += outbox[num]["BODY"] + "\n";
+        ret += query_body(outbox[num]) + "\n";
         outbox[num]["READ"] = 1;
         curr_out_msg = num;
         save_mailbox();
@@ -611,7 +616,7 @@ protected void read_message(int num) {
         ret += "DATE:    " + inbox[num]["DATE"] + "\n";
         ret += "CC:      " + implode(inbox[num]["CC"], ", ") + "\n";
         ret += "____________________________________________________________\n";
-        ret += inbox[num]["BODY"] + "\n";
+        ret += query_body(inbox[num]) + "\n";
         inbox[num]["READ"] = 1;
         curr_in_msg = num;
         save_mailbox();
@@ -829,7 +834,7 @@ void callback_exit() {
         body += "> SUBJECT: " + (gflag ? outbox[greply]["SUBJECT"] + "\n" : inbox[greply]["SUBJECT"] + "\n");
         body += "> DATE: " + (gflag ? outbox[greply]["DATE"] + "\n" : inbox[greply]["DATE"] + "\n");
         body += "> CC: " + (gflag ? implode(outbox[greply]["CC"], ", ") + "\n" : implode(inbox[greply]["CC"], ", ") + "\n> ");
-        body += "\n> " + implode(explode((gflag ? outbox[greply]["BODY"] : inbox[greply]["BODY"]), "\n"), "\n> ");
+        body += "\n> " + implode(explode(query_body(gflag ? outbox[greply] : inbox[greply]), "\n"), "\n> ");
     } else if(gforward) {
         body += "\n\n> ----------FORWARDED MESSAGE----------\n";
         body += "> FROM: " + (gflag ? outbox[gforward]["FROM"] + "\n" : inbox[gforward]["FROM"] + "\n");
@@ -837,7 +842,7 @@ void callback_exit() {
         body += "> SUBJECT: " + (gflag ? outbox[gforward]["SUBJECT"] + "\n" : inbox[gforward]["SUBJECT"] + "\n");
         body += "> DATE: " + (gflag ? outbox[gforward]["DATE"] + "\n" : inbox[gforward]["DATE"] + "\n");
         body += "> CC: " + (gflag ? implode(outbox[gforward]["CC"], ", ") + "\n" : implode(inbox[gforward]["CC"], ", ") + "\n> ");
-        body += "\n> " + implode(explode((gflag ? outbox[gforward]["BODY"] : inbox[gforward]["BODY"]), "\n"), "\n> ");
+        body += "\n> " + implode(explode(query_body(gflag ? outbox[gforward] : inbox[gforward]), "\n"), "\n> ");
     }
 
     if(!body || !did_write) {
@@ -900,26 +905,31 @@ int has_new_mail() {
 protected void resync_mailbox() {
     mapping vars = ([]);
 
-    if(file_exists(save_path)) {
-        inbox = ([]);
-        outbox = ([]);
-        vars = MAIL_D->restore(owner);
-        inbox = vars["inbox"];
-        outbox = vars["outbox"];
-        curr_in_msg = vars["curr_in_msg"];
-        curr_out_msg = vars["curr_out_msg"];
-        in_start_index = vars["in_start_index"];
-        in_end_index = vars["in_end_index"];
-        out_start_index = vars["out_start_index"];
-        out_end_index = vars["out_end_index"];
-        max_in_msgs = sizeof(inbox);
-        max_out_msgs = sizeof(outbox);
-
-        if(curr_in_msg > sizeof(inbox)) curr_in_msg = sizeof(inbox);
-        if(curr_out_msg > sizeof(outbox)) curr_out_msg = sizeof(outbox);
-    }
+    inbox = ([]);
+    outbox = ([]);
+    vars = MAIL_D->restore(owner);
+    inbox = vars["inbox"];
+    outbox = vars["outbox"];
+    curr_in_msg = vars["curr_in_msg"];
+    curr_out_msg = vars["curr_out_msg"];
+    in_start_index = vars["in_start_index"];
+    in_end_index = vars["in_end_index"];
+    out_start_index = vars["out_start_index"];
+    out_end_index = vars["out_end_index"];
+    max_in_msgs = sizeof(inbox);
+    max_out_msgs = sizeof(outbox);
+
+    if(curr_in_msg > sizeof(inbox)) curr_in_msg = sizeof(inbox);
+    if(curr_out_msg > sizeof(outbox)) curr_out_msg = sizeof(outbox);
 }//END resync_mailbox
 
+protected string query_body(mapping header) {
+    if(!mapp(header))
+        return "";
+
+    return MAIL_D->query_body(owner, header["ID"]) || "";
+}
+
 protected void save_mailbox() {
     MAIL_D->save(owner, inbox, outbox, ({ curr_in_msg, curr_out_msg, in_start_index, in_end_index, out_start_index, out_end_index }));
 }
@@ -935,7 +945,7 @@ protected mixed save_message(string path, mapping message) {
         text += "DATE:    " + message[0]["DATE"] + "\n";
         text += "CC:      " + implode(message[0]["CC"], ", ") + "\n";
         text += "____________________________________________________________\n";
-        text += message[0]["BODY"] + "\n";
+        text += query_body(message[0]) + "\n";
     } else {
         for(i = 0; i < sizeof(message); i++) {
             text += "FROM:    " + message[i]["FROM"] + "\n";
@@ -944,7 +954,7 @@ protected mixed save_message(string path, mapping message) {
             text += "DATE:    " + message[i]["DATE"] + "\n";
             text += "CC:      " + implode(message[i]["CC"], ", ") + "\n";
             text += "____________________________________________________________\n";
-            text += message[i]["BODY"] + "\n\n";
+            text += query_body(message[i]) + "\n\n";
             text += sprintf("%79'='s\n%79'='s\n\n\n\n", "", "");
         }
     }
@@ -3,12 +3,18 @@
  * @description Object for permanent or temporary storage, like shops or
  *              armouries.
  *
+ * Stock is kept as records rather than as real objects. Each record holds
+ * an item's saved state, its count and what is needed to list and match it
+ * without cloning. Identical items share a single record. An object is only
+ * cloned again when it is taken out or inspected.
+ *
  * @created 2024-08-01 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-08-01 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Added documentation
+ * 2026-10-17 - Gesslar - Record-based stock
  */
 
 #include <classes.h>
@@ -20,9 +26,25 @@ inherit CLASS_STORAGE;
 
 public nomask void save_contents();
 private nomask void restore_contents();
+public int deposit(object ob);
+public varargs int stock(string file, int count);
+public object clone_record(string key);
+public object withdraw(string key, object dest);
+public string find_record(string str);
+private void absorb_inventory();
+
+// Record layout
+#define RECORD_FILE  "file"
+#define RECORD_DATA  "data"
+#define RECORD_COUNT "count"
+#define RECORD_SHORT "short"
+#define RECORD_IDS   "ids"
+#define RECORD_VALUE "value"
 
 private nomask class StorageOptions storage_options;
 private nosave string link;
+// saved state -> record
+private nosave mapping records = ([ ]);
 
 /**
  * Initialises the storage object with default settings.
@@ -117,8 +139,10 @@ public nomask void save_contents() {
 
             assure_file(dest);
 
-            if(sizeof(all_inventory())) {
-                data = save_to_string(1);
+            absorb_inventory();
+
+            if(sizeof(records)) {
+                data = save_variable(([ "#records#" : values(records) ]));
                 write_file(dest, data, 1);
             } else {
                 if(file_exists(dest))
@@ -154,9 +178,21 @@ public nomask void restore_contents() {
             );
 
             if(file_exists(dest)) {
+                mixed saved;
+
                 data = read_file(dest);
-                if(sizeof(data))
-                    load_from_string(data, 1);
+                if(sizeof(data)) {
+                    saved = restore_variable(data);
+
+                    // Older saves hold the real inventory; load it and turn
+                    // it into records.
+                    if(mapp(saved) && pointerp(saved["#records#"])) {
+                        foreach(mapping record in saved["#records#"])
+                            records[record[RECORD_DATA]] = record;
+                    } else {
+                        load_from_string(data, 1);
+                    }
+                }
 
                 save_contents();
             }
@@ -164,6 +200,210 @@ public nomask void restore_contents() {
     }
 }
 
+/**
+ * Turns an object into a record and destructs it. Identical objects share a
+ * record, so its count goes up instead.
+ *
+ * @param {object} ob - The object to record
+ * @param {int} count - How many of it to add
+ */
+private void record_object(object ob, int count) {
+    string data = ob->save_to_string(1);
+    mapping record = records[data];
+
+    if(record) {
+        record[RECORD_COUNT] += count;
+    } else {
+        records[data] = ([
+            RECORD_FILE  : base_name(ob),
+            RECORD_DATA  : data,
+            RECORD_COUNT : count,
+            RECORD_SHORT : get_short(ob),
+            RECORD_IDS   : ob->query_ids() + ({ }),
+            RECORD_VALUE : ob->query_value(),
+        ]);
+    }
+
+    ob->remove();
+    if(objectp(ob))
+        destruct(ob);
+}
+
+/**
+ * Records anything that has been moved into the storage directly.
+ */
+private void absorb_inventory() {
+    foreach(object ob in all_inventory())
+        record_object(ob, 1);
+}
+
+/**
+ * Moves an object into storage, keeping it as a record.
+ *
+ * @param {object} ob - The object to store
+ * @returns {int} 1 if it was stored, 0 if it could not be moved in
+ */
+public int deposit(object ob) {
+    if(!objectp(ob) || ob->move(this_object()))
+        return 0;
+
+    record_object(ob, 1);
+
+    return 1;
+}
+
+/**
+ * Adds stock of a file by cloning it once and recording the result.
+ *
+ * @param {string} file - The file to stock
+ * @param {int} [count=1] - How many to add
+ * @returns {int} 1 if the stock was added, 0 if the file could not be cloned
+ */
+public varargs int stock(string file, int count) {
+    object ob;
+    string e;
+
+    if(count < 1)
+        count = 1;
+
+    e = catch(ob = new(file));
+    if(e || !objectp(ob)) {
+        if(e)
+            log_file("storage_errors", e);
+        return 0;
+    }
+
+    record_object(ob, count);
+
+    return 1;
+}
+
+/**
+ * Removes every record.
+ */
+public void clear_records() {
+    records = ([ ]);
+}
+
+/**
+ * Returns the keys of all records, ordered by their short descriptions.
+ *
+ * @returns {string*} The record keys
+ */
+public string *query_record_keys() {
+    return sort_array(keys(records), (: strcmp($(records)[$1][RECORD_SHORT], $(records)[$2][RECORD_SHORT]) :));
+}
+
+/**
+ * Returns a copy of a record.
+ *
+ * @param {string} key - The record key
+ * @returns {mapping} The record, or 0 if there is none
+ */
+public mapping query_record(string key) {
+    return records[key] ? copy(records[key]) : 0;
+}
+
+/**
+ * Returns the total number of items held as records.
+ *
+ * @returns {int} The number of items
+ */
+public int query_record_total() {
+    int total;
+
+    foreach(string key, mapping record in records)
+        total += record[RECORD_COUNT];
+
+    return total;
+}
+
+/**
+ * Finds the record matching an id, optionally followed by a number to pick
+ * among several matches, as in "sword 2".
+ *
+ * @param {string} str - The id to match
+ * @returns {string} The key of the matching record, or 0 if none match
+ */
+public string find_record(string str) {
+    string base;
+    int which;
+
+    if(!stringp(str))
+        return 0;
+
+    if(sscanf(str, "%s %d", base, which) != 2) {
+        base = str;
+        which = 1;
+    }
+
+    foreach(string key in query_record_keys()) {
+        if(member_array(base, records[key][RECORD_IDS]) == -1)
+            continue;
+
+        which -= records[key][RECORD_COUNT];
+        if(which <= 0)
+            return key;
+    }
+
+    return 0;
+}
+
+/**
+ * Clones a new object from a record without taking it out of storage, for
+ * inspecting it. The caller is responsible for removing it.
+ *
+ * @param {string} key - The record key
+ * @returns {object} The new object, or 0 if it could not be cloned
+ */
+public object clone_record(string key) {
+    mapping record = records[key];
+    object ob;
+    string e;
+
+    if(!record)
+        return 0;
+
+    e = catch {
+        ob = new(record[RECORD_FILE]);
+        ob->load_from_string(record[RECORD_DATA], 1);
+    };
+
+    if(e) {
+        log_file("storage_errors", e);
+        if(objectp(ob))
+            ob->remove();
+        return 0;
+    }
+
+    return ob;
+}
+
+/**
+ * Takes one item out of a record and moves it to a destination.
+ *
+ * @param {string} key - The record key
+ * @param {object} dest - Where to move the item
+ * @returns {object} The item, or 0 if it could not be cloned or moved
+ */
+public object withdraw(string key, object dest) {
+    mapping record = records[key];
+    object ob = clone_record(key);
+
+    if(!objectp(ob))
+        return 0;
+
+    if(ob->move(dest)) {
+        ob->remove();
+        return 0;
+    }
+
+    if(--record[RECORD_COUNT] < 1)
+        map_delete(records, key);
+
+    return ob;
+}
+
 /**
  * Sets whether the storage object should be cleaned up when empty.
  *
@@ -244,7 +484,8 @@ string query_storage_directory() {
  * @returns {int} 1 if the object should be cleaned up, 0 if not
  */
 int request_clean_up() {
-    if(sizeof(all_inventory()) == 0 && classp(storage_options) &&
+    if(sizeof(all_inventory()) == 0 && sizeof(records) == 0 &&
+       classp(storage_options) &&
        storage_options.clean_on_empty)
         return 1;
 
@@ -5,10 +5,20 @@
  *              and accepts incoming connections.
  *
  * @created 2024-07-05 - Gesslar
- * @last_modified 2024-07-05 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
+ *
+ * Each connection keeps its own input buffer and parse state, so a request
+ * may arrive over any number of reads and several may arrive in one.
+ * Requests on a connection are answered one at a time, in order. HTTP/1.1
+ * connections stay open until the client asks to close, the request limit
+ * is reached, or they sit idle for the keep-alive timeout.
  *
  * @history
  * 2024-07-05 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Persistent connections, pipelining and incremental
+ *                        request parsing
+ * 2026-10-17 - Gesslar - Handler-supplied headers and encodings, bodyless
+ *                        304 and 204 responses
  */
 
 // /adm/daemons/http_server.c
@@ -34,16 +44,21 @@ protected nomask void send_http_response(int fd, mapping client);
 protected nomask void close_client_connection(int fd);
 protected nomask void close_all_client_connections();
 protected nomask void socket_shutdown(int fd);
+protected nomask void process_requests(int fd);
+private nomask mixed next_request(mapping client);
+private nomask mapping parse_request_head(string str);
+private nomask void dispatch_request(int fd, mapping client, mapping request);
+private nomask void sweep_idle_clients();
 
 // Variables
 private nomask nosave int LISTEN_PORT = 8080;
 private nomask nosave mapping clients = ([ ]);
 private nomask nosave mapping standard_headers = ([]);
+private nomask nosave int sweeping = 0;
 
 void mudlib_setup() {
     standard_headers = ([
         "Server": "FluffOS",
-        "Connection": "close",
         "Date" : (: http_time_string :),
         "Content-Length": (: http_content_length :),
     ]);
@@ -66,7 +81,7 @@ protected nomask int query_listen_port() {
 protected nomask void start_server() {
     int fd, status;
 
-    fd = socket_create(get_option("tls") ? STREAM_TLS_BINARY : STREAM_BINARY, "socket_read", "socket_close");
+    fd = socket_create(get_option("tls") ? STREAM_TLS_BINARY : STREAM_BINARY, "socket_read", "socket_closed");
 
     if(fd < 0) {
         _log(0, "Unable to create socket: %s", socket_error(fd));
@@ -104,10 +119,23 @@ protected nomask void socket_listen(int fd) {
     client_address = socket_address(client_fd);
     sscanf(client_address, "%s %d", client_host, client_port);
 
+    // input:   bytes received but not yet parsed
+    // scan:    where to resume looking for the end of the headers
+    // pending: a parsed request head still waiting for its body
+    // busy:    a request has been dispatched and not yet answered
+    // blocked: the last response is still being flushed by the driver
     client = ([
         "host": client_host,
         "port": client_port,
         "time": time_frac(),
+        "last": time(),
+        "input": allocate_buffer(0),
+        "scan": 0,
+        "pending": 0,
+        "busy": 0,
+        "blocked": 0,
+        "served": 0,
+        "keep_alive": 0,
         "http" : ([
             "request": ([ ]),
             "response": ([ ]),
@@ -122,14 +150,45 @@ protected nomask void socket_listen(int fd) {
     }
 
     clients[client_fd] = client;
+
+    if(!sweeping) {
+        sweeping = 1;
+        call_out((: sweep_idle_clients :), HTTP_KEEP_ALIVE_TIMEOUT);
+    }
 }
 
+// The driver has finished flushing a response that did not go out in one
+// write; carry on with whatever else the client has sent.
 void socket_ready(int fd) {
+    mapping client = clients[fd];
+
     _log(3, SYSTEM_OK "=> Socket ready: %d{{res}}", fd);
+
+    if(!client || !client["blocked"])
+        return;
+
+    client["blocked"] = 0;
+
+    if(!client["keep_alive"] && !client["busy"])
+        socket_shutdown(fd);
+    else
+        process_requests(fd);
+}
+
+nomask void socket_closed(int fd) {
+    mapping client = clients[fd];
+
+    if(!client)
+        return;
+
+    _log(2, "Connection closed by client: %s %d", client["host"], client["port"]);
+
+    map_delete(clients, fd);
+    call_if(this_object(), "http_handle_shutdown", client);
 }
 
 nomask void close_all_client_connections() {
-    foreach(int fd, mapping client in clients) {
+    foreach(int fd in keys(clients)) {
         close_client_connection(fd);
     }
 }
@@ -142,11 +201,11 @@ protected nomask void socket_shutdown(int fd) {
     mapping client = clients[fd];
     int result;
 
-    _log(1, "Shutting down connection: %s %d", client["host"], client["port"]);
-
     if(!client)
         return;
 
+    _log(1, "Shutting down connection: %s %d", client["host"], client["port"]);
+
     result = socket_close(fd);
     if(result != EESUCCESS) {
         _log(0, "Error closing socket: %s", socket_error(result));
@@ -154,16 +213,35 @@ protected nomask void socket_shutdown(int fd) {
         _log(3, "Removing socket: %s %d", client["host"], client["port"]);
     }
 
-    call_if(client, "http_handle_shutdown", client);
-
     map_delete(clients, fd);
+
+    call_if(this_object(), "http_handle_shutdown", client);
+}
+
+private nomask void sweep_idle_clients() {
+    int timeout = get_option("keep_alive_timeout") || HTTP_KEEP_ALIVE_TIMEOUT;
+    int now = time();
+
+    foreach(int fd in keys(clients)) {
+        mapping client = clients[fd];
+
+        if(!client || client["busy"] || client["blocked"])
+            continue;
+
+        if(now - client["last"] >= timeout) {
+            _log(2, "Closing idle connection: %s %d", client["host"], client["port"]);
+            socket_shutdown(fd);
+        }
+    }
+
+    if(sizeof(clients))
+        call_out((: sweep_idle_clients :), timeout);
+    else
+        sweeping = 0;
 }
 
 protected nomask void socket_read(int fd, buffer incoming) {
-    mixed err;
-    mapping result;
     mapping client;
-    string buf;
 
     if(!bufferp(incoming))
         return;
@@ -174,39 +252,204 @@ protected nomask void socket_read(int fd, buffer incoming) {
         return;
     }
 
-    buf = to_string(incoming);
-    _log(3, "Received: %O", buf);
+    _log(3, "Received %d bytes from %s %d", sizeof(incoming), client["host"], client["port"]);
+
+    // Once a response has said the connection is closing, nothing more
+    // from this client will be answered.
+    if(client["closing"])
+        return;
 
-    err = catch(result = parse_http_request(incoming));
-    // _log(3, "Result: %O", result);
-    if(err || !mapp(result)) {
-        _log(2, "Error parsing: %O", err);
+    client["input"] += incoming;
+    client["last"] = time();
 
-        client["response"] = ([
-            "status": HTTP_STATUS_BAD_REQUEST,
-            "content-type": CONTENT_TYPE_TEXT_PLAIN,
-        ]);
-        send_http_response(fd, client);
+    process_requests(fd);
+}
+
+// Answers every complete request in the client's input, one at a time. A
+// handler that responds later leaves the client busy, and the rest of the
+// input waits until send_http_response() picks it up again.
+protected nomask void process_requests(int fd) {
+    mapping client = clients[fd];
+    mixed request;
+
+    if(!client || client["processing"])
         return;
+
+    client["processing"] = 1;
+
+    while(clients[fd] && !client["busy"] && !client["blocked"] && !client["closing"]) {
+        request = next_request(client);
+
+        if(!request)
+            break;
+
+        if(stringp(request)) {
+            // The stream can't be trusted past a bad request, so answer it
+            // and close.
+            client["busy"] = 1;
+            client["keep_alive"] = 0;
+            client["closing"] = 1;
+            client["http"] = ([
+                "request": ([ "headers": ([ ]) ]),
+                "response": ([
+                    "status": request,
+                    "content-type": CONTENT_TYPE_TEXT_PLAIN,
+                ]),
+            ]);
+            send_http_response(fd, client);
+            break;
+        }
+
+        dispatch_request(fd, client, request);
     }
 
-    // _log(3, "Parsed: %O", result);
+    client["processing"] = 0;
+}
+
+// Takes the next request off the client's input. Returns the request, 0 if
+// more input is needed, or a status string if the request is unacceptable.
+private nomask mixed next_request(mapping client) {
+    buffer input = client["input"];
+    mapping request = client["pending"];
+    int sz = sizeof(input);
+    int length, i;
+
+    if(!request) {
+        int start, end = -1;
+
+        // Blank lines ahead of a request are allowed and ignored.
+        while(start < sz && (input[start] == '\r' || input[start] == '\n'))
+            start++;
+
+        if(start) {
+            input = input[start..];
+            sz = sizeof(input);
+            client["input"] = input;
+            client["scan"] = 0;
+        }
 
-    if(result == 0) {
-        client["response"] = ([
-            "status": HTTP_STATUS_BAD_REQUEST,
-            "content-type": CONTENT_TYPE_TEXT_PLAIN,
-        ]);
-        send_http_response(fd, client);
-        return;
+        // Only the bytes that arrived since the last look are searched.
+        for(i = client["scan"]; i + 3 < sz; i++) {
+            if(input[i] == '\r' && input[i+1] == '\n' && input[i+2] == '\r' && input[i+3] == '\n') {
+                end = i;
+                break;
+            }
+        }
+
+        if(end == -1) {
+            if(sz > HTTP_MAX_HEADER_SIZE)
+                return HTTP_STATUS_HEADERS_TOO_LARGE;
+
+            client["scan"] = sz > 3 ? sz - 3 : 0;
+            return 0;
+        }
+
+        if(end > HTTP_MAX_HEADER_SIZE)
+            return HTTP_STATUS_HEADERS_TOO_LARGE;
+
+        if(catch(request = parse_request_head(to_string(input[0..end-1]))) || !request)
+            return HTTP_STATUS_BAD_REQUEST;
+
+        if(request["headers"]["transfer-encoding"])
+            return HTTP_STATUS_NOT_IMPLEMENTED;
+
+        length = request["headers"]["content-length"];
+        if(!intp(length) || length < 0)
+            return HTTP_STATUS_BAD_REQUEST;
+
+        if(length > get_config(__MAX_BUFFER_SIZE__))
+            return HTTP_STATUS_PAYLOAD_TOO_LARGE;
+
+        input = input[end+4..];
+        sz = sizeof(input);
+
+        client["input"] = input;
+        client["scan"] = 0;
+        client["pending"] = request;
+    }
+
+    length = request["headers"]["content-length"];
+    if(sz < length)
+        return 0;
+
+    if(length) {
+        if(catch(request["body"] = parse_body(input[0..length-1], request["headers"]["content-type"])))
+            return HTTP_STATUS_BAD_REQUEST;
+
+        client["input"] = input[length..];
     }
 
-    clients[fd]["http"]["request"] = result;
+    client["pending"] = 0;
+
+    return request;
+}
+
+// Parses the request line and headers, everything before the blank line.
+private nomask mapping parse_request_head(string str) {
+    mapping result = ([ ]);
+    int pos = strsrch(str, "\r\n");
+
+    result["request"] = parse_http_request_line(pos == -1 ? str : str[0..pos-1]);
+    _log(3, "Request line: %O", result["request"]);
+    if(!result["request"])
+        return 0;
+
+    result["route"] = parse_route(result["request"]["path"]);
+    _log(3, "Request route: %O", result["route"]);
+    if(!result["route"])
+        return 0;
+
+    if(pos == -1)
+        result["headers"] = ([ ]);
+    else
+        result["headers"] = parse_headers(str[pos+2..] + "\r\n", 0);
+
+    _log(3, "Request headers: %O", result["headers"]);
+    if(!result["headers"])
+        return 0;
+
+    return result;
+}
+
+private nomask void dispatch_request(int fd, mapping client, mapping request) {
+    mixed connection = request["headers"]["connection"];
+    mixed err;
+
+    connection = pointerp(connection) ? map(connection, (: lower_case :)) : ({ });
+
+    client["busy"] = 1;
+    client["served"]++;
+
+    if(get_option("close") || client["served"] >= HTTP_KEEP_ALIVE_MAX)
+        client["keep_alive"] = 0;
+    else if(member_array("close", connection) > -1)
+        client["keep_alive"] = 0;
+    else if(request["request"]["version"] == "1.0")
+        client["keep_alive"] = member_array("keep-alive", connection) > -1;
+    else
+        client["keep_alive"] = 1;
+
+    client["http"] = ([
+        "request": request,
+        "response": ([ ]),
+    ]);
 
     if(function_exists("http_handle_request")) {
-        catch(call_other(this_object(), "http_handle_request", fd, client));
+        err = catch(call_other(this_object(), "http_handle_request", fd, client));
+
+        if(err) {
+            _log(0, "Error handling request: %O", err);
+
+            if(clients[fd] && client["busy"]) {
+                client["http"]["response"] = ([
+                    "status": HTTP_STATUS_INTERNAL_SERVER_ERROR,
+                    "content-type": CONTENT_TYPE_TEXT_PLAIN,
+                ]);
+                send_http_response(fd, client);
+            }
+        }
     } else {
-        client["response"] = ([
+        client["http"]["response"] = ([
             "status": HTTP_STATUS_NOT_IMPLEMENTED,
             "content-type": CONTENT_TYPE_TEXT_PLAIN,
         ]);
@@ -215,31 +458,53 @@ protected nomask void socket_read(int fd, buffer incoming) {
 }
 
 protected nomask void send_http_response(int fd, mapping client) {
-    string response = "";
-    mapping headers = standard_headers;
+    string head = "";
+    mapping headers, request, response;
     mixed body;
     string status, content_type;
     int result;
 
-    if(!fd || !client || !client["http"]["response"]["status"] || !client["http"]["response"]["content-type"])
-        return;
-
     if(!client) {
         _log(0, "Unknown client: %d", fd);
         return;
     }
 
-    body = client["http"]["response"]["body"];
-    status = client["http"]["response"]["status"];
+    request = client["http"]["request"] || ([ ]);
+    response = client["http"]["response"];
+
+    if(!fd || !mapp(response) || !response["status"] || !response["content-type"])
+        return;
+
+    // The standard headers are shared by every response, so work on a copy.
+    headers = standard_headers + ([ ]);
+
+    body = response["body"];
+    status = response["status"];
+
+    // Extra headers from the handler, eg the validators on a static file.
+    if(mapp(response["headers"]))
+        headers += response["headers"];
+
+    if(status == HTTP_STATUS_NOT_MODIFIED || status == HTTP_STATUS_NO_CONTENT) {
+        // These never carry a body.
+        map_delete(headers, "Content-Length");
+        body = allocate_buffer(0);
+    } else if(body && response["content-encoding"]) {
+        // Already encoded, eg a precompressed static file.
+        if(stringp(body))
+            body = to_binary(body);
+
+        headers["Content-Encoding"] = response["content-encoding"];
+    } else if(body) {
+        if(stringp(body))
+            body = to_binary(body);
 
-    if(body) {
-        if(client["http"]["request"]["headers"]["accept-encoding"]) {
-            string *accepts = client["http"]["request"]["headers"]["accept-encoding"];
+        if(pointerp(request["headers"]["accept-encoding"])) {
+            string *accepts = request["headers"]["accept-encoding"];
             if(member_array("deflate", accepts) > -1 && get_option("deflate")) {
                 headers["Content-Encoding"] = "deflate";
+                headers["Vary"] = "Accept-Encoding";
                 body = compress(body);
-                client["http"]["response"]["body"] = body;
-            } else {
             }
         }
     }
@@ -249,15 +514,15 @@ protected nomask void send_http_response(int fd, mapping client) {
             case HTTP_STATUS_OK:
             case HTTP_STATUS_CREATED:
             case HTTP_STATUS_ACCEPTED:
-            case HTTP_STATUS_NO_CONTENT:
             case HTTP_STATUS_MOVED_PERMANENTLY:
             case HTTP_STATUS_FOUND:
-            case HTTP_STATUS_NOT_MODIFIED:
             case HTTP_STATUS_BAD_REQUEST:
             case HTTP_STATUS_UNAUTHORIZED:
             case HTTP_STATUS_FORBIDDEN:
             case HTTP_STATUS_NOT_FOUND:
             case HTTP_STATUS_METHOD_NOT_ALLOWED:
+            case HTTP_STATUS_PAYLOAD_TOO_LARGE:
+            case HTTP_STATUS_HEADERS_TOO_LARGE:
             case HTTP_STATUS_INTERNAL_SERVER_ERROR:
             case HTTP_STATUS_NOT_IMPLEMENTED:
             case HTTP_STATUS_BAD_GATEWAY:
@@ -266,13 +531,25 @@ protected nomask void send_http_response(int fd, mapping client) {
                 break;
             default: body = status; break;
         }
+
+        body = to_binary(body);
     }
 
-    content_type = client["http"]["response"]["content-type"];
+    // Content-Length is worked out from the body as it will be sent.
+    response["body"] = body;
+
+    content_type = response["content-type"];
     // Build the HTTP response
-    headers += ([
-        "Content-Type": content_type,
-    ]);
+    headers["Content-Type"] = content_type;
+
+    if(client["keep_alive"]) {
+        headers["Connection"] = "keep-alive";
+        headers["Keep-Alive"] = sprintf("timeout=%d, max=%d",
+            get_option("keep_alive_timeout") || HTTP_KEEP_ALIVE_TIMEOUT,
+            HTTP_KEEP_ALIVE_MAX - client["served"]);
+    } else {
+        headers["Connection"] = "close";
+    }
 
     foreach(string header, mixed value in headers) {
         mixed val;
@@ -297,46 +574,42 @@ protected nomask void send_http_response(int fd, mapping client) {
                 break;
         }
 
-        response += sprintf("%s: %s\r\n", header, val);
+        head += sprintf("%s: %s\r\n", header, val);
     }
 
-    response += "\r\n"; // End of headers
+    head += "\r\n"; // End of headers
 
-    response = sprintf("HTTP/1.1 %s\r\n%s", status, response);
+    head = sprintf("HTTP/1.1 %s\r\n%s", status, head);
 
-    // Send the response
-    if(bufferp(body))  {
-        result = socket_write(fd, response);
-        if(result != EESUCCESS) {
-            _log(0, "Error writing response: %s", socket_error(result));
-            socket_shutdown(fd);
-            return;
-        }
-        _log(2, "Headers sent");
-        result = socket_write(fd, body);
-        if(result != EESUCCESS) {
-            _log(0, "Error writing response: %s", socket_error(result));
-            socket_shutdown(fd);
-            return;
-        }
-        _log(2, "Body sent");
-    } else {
-        response += body;
-        result = socket_write(fd, response);
-        if(result != EESUCCESS) {
-            _log(0, "Error writing response: %s", socket_error(result));
-            socket_shutdown(fd);
-            return;
-        }
-        _log(2, "Response sent");
-    }
+    // Send the response in one write. A HEAD request gets the headers only.
+    if(mapp(request["request"]) && request["request"]["method"] == "HEAD")
+        result = socket_write(fd, to_binary(head));
+    else
+        result = socket_write(fd, to_binary(head) + body);
 
-    // Properly close the connection
-    if(member_array("close", client["http"]["request"]["headers"]["connection"]) > -1) {
-        _log(2, "Closing connection per client's request (%s %d)", client["host"], client["port"]);
+    if(result != EESUCCESS && result != EECALLBACK) {
+        _log(0, "Error writing response: %s", socket_error(result));
         socket_shutdown(fd);
-    } else if(get_option("close")) {
-        _log(2, "Closing connection per server's request");
+        return;
+    }
+
+    _log(2, "Response sent");
+
+    client["busy"] = 0;
+    client["last"] = time();
+
+    // The driver is still flushing; socket_ready() takes over from here.
+    if(result == EECALLBACK) {
+        client["blocked"] = 1;
+        return;
+    }
+
+    if(!client["keep_alive"]) {
+        _log(2, "Closing connection (%s %d)", client["host"], client["port"]);
         socket_shutdown(fd);
+        return;
     }
+
+    // Anything pipelined behind this request is answered next.
+    process_requests(fd);
 }
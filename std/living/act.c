@@ -1,6 +1,6 @@
 /**
  * @file /std/living/act.c
- * @description Call-out based action module
+ * @description Scheduler based action module
  *
  * @created 2024-08-08 - Gesslar
  * @last_modified 2024-08-08 - Gesslar
@@ -28,7 +28,7 @@ int act(string action, float delay, mixed *cb) {
     delay = to_float(delay);
 
   uuid = generate_uuid();
-  id = call_out_walltime("finish_act", delay, uuid);
+  id = SCHEDULER_D->schedule(delay, "finish_act", uuid);
 
   if(caller_is(SIMUL_OB))
     po = previous_object(1);
@@ -88,7 +88,7 @@ void cancel_acts() {
   class Act act;
 
   while(classp(act = pop_act())) {
-    remove_call_out(act.id);
+    SCHEDULER_D->cancel(act.id);
     catch(call_back(act.cb, false));
   }
 }
@@ -99,7 +99,7 @@ int cancel_act(mixed action) {
   if(!classp(act = pop_act(action)))
     return 0;
 
-  remove_call_out(act.id);
+  SCHEDULER_D->cancel(act.id);
   catch(call_back(act.cb, false));
 
   return 1;
@@ -7,12 +7,27 @@
 */
 
 /* Last edited on 19-JAN-06 by Tacitus. */
+/* 2026-10-17 - Gesslar - Match against a cached merge of personal and
+   global aliases, with xverbs in a prefix trie. */
 
 #include <alias.h>
 
 mapping xverb = ([]);
 mapping alias = ([]);
 
+/* The personal aliases merged over the global ones, and a trie of the
+   merged xverbs. Rebuilt only when either side changes. */
+private nosave mapping _merged_alias;
+private nosave mapping _xverb_trie;
+private nosave int _alias_generation;
+private nosave string _alias_privs;
+private nosave mapping _alias_source, _xverb_source;
+private nosave int _alias_dirty = 1;
+
+/* Trie nodes map a character to the next node; a completed xverb keeps its
+   command under this key. */
+#define TRIE_CMD -1
+
 void add_alias(string verb, string cmd) {
   if(!adminp(previous_object()) && this_body() != this_object())
     return;
@@ -28,6 +43,8 @@ void add_alias(string verb, string cmd) {
 
     alias += ([ verb : cmd ]);
   }
+
+  _alias_dirty = 1;
 }
 
 int remove_alias(string verb) {
@@ -36,11 +53,13 @@ int remove_alias(string verb) {
 
   if(alias[verb]) {
     map_delete(alias, verb);
+    _alias_dirty = 1;
     return 1;
   }
 
   if(xverb[verb]) {
     map_delete(xverb, verb);
+    _alias_dirty = 1;
     return 1;
   }
 
@@ -119,35 +138,87 @@ string compute_alias(string al, string args) {
   return al;
 }
 
-string alias_parse(string verb, string args) {
-  string *keys;
-  int i;
-  mapping tmp_alias;
-  mapping tmp_xverb;
+private mapping build_xverb_trie(mapping xverbs) {
+  mapping trie = ([]);
+
+  foreach(string key, string cmd in xverbs) {
+    mapping node = trie;
+
+    foreach(int c in key) {
+      if(!node[c])
+        node[c] = ([]);
+
+      node = node[c];
+    }
+
+    node[TRIE_CMD] = cmd;
+  }
+
+  return trie;
+}
+
+private void refresh_alias_snapshot() {
+  int generation = GA_SERVER->query_generation();
+  string privs = query_privs();
+  mixed *global;
 
   alias = mapp(alias) ? alias : ([]);
   xverb = mapp(xverb) ? xverb : ([]);
 
-  tmp_alias = GA_SERVER->get_alias(query_privs()) + alias;
-  tmp_xverb = GA_SERVER->get_xverb(query_privs()) + xverb;
+  // restore_object() replaces the mappings without going through
+  // add_alias(), so their identity is checked as well.
+  if(!_alias_dirty &&
+     generation == _alias_generation &&
+     privs == _alias_privs &&
+     alias == _alias_source &&
+     xverb == _xverb_source)
+    return;
+
+  global = GA_SERVER->get_snapshot(privs);
+
+  _merged_alias = global[0] + alias;
+  _xverb_trie = build_xverb_trie(global[1] + xverb);
+
+  _alias_generation = generation;
+  _alias_privs = privs;
+  _alias_source = alias;
+  _xverb_source = xverb;
+  _alias_dirty = 0;
+}
+
+string alias_parse(string verb, string args) {
+  mapping node;
+  string cmd, rest;
+  int i, sz, matched;
 
-  if(sizeof(tmp_alias))
-    if(tmp_alias[verb])
-      return(compute_alias(tmp_alias[verb], args));
+  refresh_alias_snapshot();
 
-  if(sizeof(tmp_xverb)) {
-    keys = keys(tmp_xverb);
+  if(cmd = _merged_alias[verb])
+    return compute_alias(cmd, args);
 
-    for(i = 0; i < sizeof(keys); i++) {
-      if(keys[i] == verb[0..(strlen(keys[i]) - 1)]) {
-        if(args)
-          return compute_alias(tmp_xverb[keys[i]], verb[(strlen(keys[i]))..(strlen(verb) - 1)] + " " + args);
-        else
-        return compute_alias(tmp_xverb[keys[i]], verb[(strlen(keys[i]))..(strlen(verb) - 1)]);
-      }
+  // The longest xverb that prefixes the verb wins.
+  cmd = 0;
+  node = _xverb_trie;
+  sz = strlen(verb);
+  for(i = 0; i < sz; i++) {
+    if(!(node = node[verb[i]]))
+      break;
+
+    if(node[TRIE_CMD]) {
+      cmd = node[TRIE_CMD];
+      matched = i + 1;
     }
   }
 
+  if(cmd) {
+    rest = verb[matched..<1];
+
+    if(args)
+      return compute_alias(cmd, rest + " " + args);
+    else
+      return compute_alias(cmd, rest);
+  }
+
   if(args && args != "")
     return(verb + " " + args);
   else
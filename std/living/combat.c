@@ -67,7 +67,7 @@ void combat_round() {
     GMCP_LBL_CHAR_STATUS_CURRENT_ENEMIES: keys(_current_enemies),
   ]));
 
-  if(find_call_out(_next_combat_round) == -1)
+  if(!SCHEDULER_D->is_scheduled(_next_combat_round))
     next_round();
 }
 
@@ -87,7 +87,7 @@ int start_attack(object victim) {
   if(!userp())
     module("combat_memory", "add_to_memory", victim);
 
-  _next_combat_round = call_out_walltime("combat_round", _attack_speed);
+  _next_combat_round = SCHEDULER_D->schedule(_attack_speed, "combat_round");
 
   victim->start_attack(this_object());
 
@@ -150,7 +150,7 @@ int next_round() {
 
   speed += random_float(1.5);
 
-  _next_combat_round = call_out_walltime("combat_round", speed);
+  _next_combat_round = SCHEDULER_D->schedule(speed, "combat_round");
 
   return _next_combat_round;
 }
@@ -350,8 +350,8 @@ varargs int stop_attack(object victim, int seen) {
 }
 
 void stop_all_attacks() {
-  if(find_call_out(_next_combat_round) != -1)
-    remove_call_out(_next_combat_round);
+  if(_next_combat_round)
+    SCHEDULER_D->cancel(_next_combat_round);
 
   _current_enemies = ([]);
 
@@ -18,5 +18,6 @@ private nomask mapping adjust_skill_levels(mapping current_skills) ;
 string *query_skill_path(string skill) ;
 int use_skill(string skill) ;
 int assure_skill(string skill) ;
+void sync_skill_tree() ;
 
 #endif // __SKILLS_H__
@@ -230,6 +230,7 @@ void move_or_destruct(object ob) {
     }
 
     move_object(ob);
+    call_if(ob, "add_present_living", this_object());
 }
 
 mixed query_environ(string key) {
@@ -321,6 +322,7 @@ int save_body() {
         this_body() != this_object() &&
         base_name(previous_object()) != CMD_QUIT) return 0;
 
+    sync_skill_tree();
     catch(result = save_object(user_body_data(query_real_name())));
 
     save_inventory();
@@ -3,10 +3,11 @@
  * @description Trainable skills for living objects
  *
  * @created 2024-07-31 - Gesslar
- * @last_modified 2024-07-31 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-07-31 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Flat skill index, tree kept for saves and display
  */
 
 #include <skills.h>
@@ -14,16 +15,102 @@
 #include <boon.h>
 #include <npc.h>
 
+// The dotted skill tree. This is what gets saved and what is shown to
+// players, but at runtime it is only a view derived from _skill_index.
 private nomask mapping skills = ([]);
 
-void wipe_skills() {
-    skills = ([]);
+// Flat index of every skill in the tree, keyed by its full dotted name.
+// Skill names are shared strings, so lookups are a single hash probe rather
+// than an explode() and a walk down the tree.
+private nomask nosave mapping _skill_index;
+// The tree the index was built from, so a restore_object() that replaces
+// the tree is noticed and the index rebuilt.
+private nomask nosave mapping _skill_index_source;
+// Set when the index has changed and the tree needs rebuilding.
+private nomask nosave int _skill_tree_stale;
+// Cached improvement weights for each skill and its ancestors.
+private nomask nosave mapping _skill_chances = ([]);
+
+private nomask void flatten_skills(mapping tree, string prefix, mapping into);
+void sync_skill_tree();
+
+/**
+ * @description Returns the flat skill index, building it from the saved
+ *              tree if it has not been built yet or the tree was replaced.
+ * @returns {mapping} Full skill name to level
+ */
+private nomask mapping skill_index() {
+    if(mapp(_skill_index) && _skill_index_source == skills)
+        return _skill_index;
+
+    if(!mapp(skills))
+        skills = ([]);
+
+    _skill_index = ([]);
+    flatten_skills(skills, "", _skill_index);
+    _skill_index_source = skills;
+    _skill_tree_stale = 0;
+
+    return _skill_index;
+}
+
+private nomask void flatten_skills(mapping tree, string prefix, mapping into) {
+    foreach(string name, mixed node in tree) {
+        string full = prefix + name;
+
+        if(!mapp(node))
+            continue;
+
+        into[full] = node["level"];
+
+        if(mapp(node["subskills"]) && sizeof(node["subskills"]))
+            flatten_skills(node["subskills"], full + ".", into);
+    }
 }
 
 /**
- * @description Initialize missing skills from the given mapping
- * @param {mapping} skill_set - A mapping of skill names and their details
+ * @description Rebuilds the dotted skill tree from the flat index. Called
+ *              before the tree is saved or displayed.
  */
+void sync_skill_tree() {
+    mapping tree = ([]);
+    mapping index = skill_index();
+
+    if(!_skill_tree_stale)
+        return;
+
+    foreach(string skill in sort_array(keys(index), 1)) {
+        string *path = explode(skill, ".");
+        mapping current = tree;
+        string name = "";
+        int x, sz = sizeof(path);
+
+        for(x = 0; x < sz; x++) {
+            name += (x ? "." : "") + path[x];
+
+            if(!mapp(current[path[x]])) {
+                current[path[x]] = ([
+                    "level" : of(name, index) ? index[name] : 1.0,
+                    "subskills" : ([]),
+                ]);
+            }
+
+            current = current[path[x]]["subskills"];
+        }
+    }
+
+    skills = tree;
+    _skill_index_source = skills;
+    _skill_tree_stale = 0;
+}
+
+void wipe_skills() {
+    skills = ([]);
+    _skill_index = ([]);
+    _skill_index_source = skills;
+    _skill_tree_stale = 0;
+}
+
 /**
  * @description Initialize missing skills from the given mapping
  * @param {mapping} skill_set - A mapping of skill categories and skills
@@ -62,47 +149,49 @@ varargs void initialize_missing_skills(mapping skill_set, string curr_path) {
  */
 
 varargs int add_skill(string skill, float level) {
-    string *path = explode(skill, ".");
-    mapping current = skills;
+    mapping index;
+    string *path, name = "";
     int x, sz;
 
     if(!stringp(skill) || nullp(level) || level < 1.0)
         return null;
 
+    index = skill_index();
+    if(of(skill, index))
+        return 1;
+
+    path = explode(skill, ".");
     sz = sizeof(path);
     for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]])) {
-            current[path[x]] = ([
-                "level" : (x == sz - 1 ? level : 1.0),
-                "subskills" : ([]),
-            ]);
+        name += (x ? "." : "") + path[x];
+
+        if(!of(name, index)) {
+            index[name] = (x == sz - 1 ? level : 1.0);
+            _skill_tree_stale = 1;
         }
-        current = current[path[x]]["subskills"];
     }
+
     return 1;
 }
 
 int remove_skill(string skill) {
-    string *path;
-    mapping current = skills;
-    int x, sz;
+    mapping index;
+    string prefix;
 
     if(!stringp(skill))
         return null;
 
-    path = explode(skill, ".");
-    sz = sizeof(path);
+    index = skill_index();
+    if(!of(skill, index))
+        return 0;  // Unable to find
 
-    for(x = 0; x < sz - 1; x++) {
-        if(!mapp(current) || !current[path[x]] || !mapp(current[path[x]]["subskills"]))
-            return 0;  // Unable to find
-        current = current[path[x]]["subskills"];
-    }
+    prefix = skill + ".";
+    foreach(string name in keys(index))
+        if(name == skill || strsrch(name, prefix) == 0)
+            map_delete(index, name);
 
-    if(!mapp(current) || !current[path[sz-1]])
-        return 0;  // Unable to find
+    _skill_tree_stale = 1;
 
-    map_delete(current, path[sz-1]);
     return 1;  // Success
 }
 
@@ -112,52 +201,31 @@ int remove_skill(string skill) {
  * @returns {float} The level of the skill as an integer
  */
 float query_skill(string skill) {
-    string *path = explode(skill, ".");
-    mapping current = skills;
-    int x, sz;
-
     if(!stringp(skill))
         return null;
 
     if(function_exists("is_npc") && is_npc())
         return query_level() * 3.0;
 
-    sz = sizeof(path);
-    for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]]))
-            return null;
-        if(x == sz - 1)
-            return current[path[x]]["level"];
-        current = current[path[x]]["subskills"];
-    }
-
-    return null;
+    return skill_index()[skill];
 }
 
 varargs float query_skill_level(string skill, int raw) {
-    string *path = explode(skill, ".");
-    mapping current = skills;
-    int x, sz;
+    mapping index;
+    float lvl;
 
     if(!stringp(skill))
         return null;
 
-    sz = sizeof(path);
-    for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]]))
-            return null;
-        if(x == sz - 1) {
-            float lvl = floor(current[path[x]]["level"]);
-            if(raw)
-                return lvl;
-            else
-                return lvl + query_effective_boon("skill", skill);
-        }
-
-        current = current[path[x]]["subskills"];
-    }
+    index = skill_index();
+    if(!of(skill, index))
+        return null;
 
-    return null;
+    lvl = floor(index[skill]);
+    if(raw)
+        return lvl;
+    else
+        return lvl + query_effective_boon("skill", skill);
 }
 
 /**
@@ -166,23 +234,19 @@ varargs float query_skill_level(string skill, int raw) {
  * @param {float} level - The level of the skill with fractional progress
  */
 int set_skill_level(string skill, float level) {
-    string *path = explode(skill, ".");
-    mapping current = skills;
-    int x, sz;
+    mapping index;
 
     if(!stringp(skill) || nullp(level) || level < 1.0)
         return null;
 
-    sz = sizeof(path);
-    for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]])) return 0;
-        if(x == sz - 1) {
-            current[path[x]]["level"] = level;
-            return 1;
-        }
-        current = current[path[x]]["subskills"];
-    }
-    return null;
+    index = skill_index();
+    if(!of(skill, index))
+        return 0;
+
+    index[skill] = level;
+    _skill_tree_stale = 1;
+
+    return 1;
 }
 
 /**
@@ -191,6 +255,8 @@ int set_skill_level(string skill, float level) {
  */
 
 mapping query_skills() {
+    sync_skill_tree();
+
     return copy(skills);
 }
 
@@ -243,9 +309,8 @@ string *query_skill_path(string skill) {
  * @param {float} progress - The fractional progress to add to the skill level
  */
 varargs float improve_skill(string skill, float progress) {
-    string *path = explode(skill, ".");
-    mapping current = skills;
-    int x, sz = sizeof(path);
+    mapping index;
+    float level, new_level;
 
     if(!stringp(skill))
         return null;
@@ -256,86 +321,69 @@ varargs float improve_skill(string skill, float progress) {
     // skill tree leading to the specified skill and apply
     // a random amount of progress to it.
     if(nullp(progress)) {
-        mapping chances = ([]);
-        string p;
-        int i = sz;
+        mapping chances = _skill_chances[skill];
 
-        while(i--)
-            chances[implode(path[0..i], ".")] = (i+1) * 3;
+        if(!mapp(chances)) {
+            string *path = explode(skill, ".");
+            int i = sizeof(path);
+
+            chances = ([]);
+            while(i--)
+                chances[implode(path[0..i], ".")] = (i+1) * 3;
+
+            _skill_chances[skill] = chances;
+        }
 
         skill = element_of_weighted(chances);
         progress = random_float(0.01);
-
-        path = explode(skill, ".");
-        sz = sizeof(path);
     }
 
-    for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]]))
-            return 0;
-        if(x == sz - 1) {
-            float level = query_skill_level(skill, 1), new_level;
-            current[path[x]]["level"] += progress;
-            new_level = query_skill_level(skill, 1);
-            if(new_level > level)
-                tell(this_object(), "You have improved your " + skill + " skill.\n");
-
-            return progress;
-        }
-        current = current[path[x]]["subskills"];
-    }
+    index = skill_index();
+    if(!of(skill, index))
+        return 0;
 
-    return null;
+    level = floor(index[skill]);
+    index[skill] += progress;
+    new_level = floor(index[skill]);
+    _skill_tree_stale = 1;
+
+    if(new_level > level)
+        tell(this_object(), "You have improved your " + skill + " skill.\n");
+
+    return progress;
 }
 
 int query_skill_progress(string skill) {
-    string *path;
-    mapping current = skills;
-    int x, sz;
+    mapping index;
     float level, fractional_part;
 
     if(!stringp(skill))
         return null; // Return null for invalid input
 
-    path = explode(skill, ".");
-    sz = sizeof(path);
+    index = skill_index();
+    if(!of(skill, index))
+        return null; // Return null if the skill doesn't exist
 
-    for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]]))
-            return null; // Return null if the skill path doesn't exist
+    level = index[skill];
+    fractional_part = level - floor(level);
 
-        if(x == sz - 1) {
-            level = current[path[x]]["level"];
-            fractional_part = level - floor(level);
-            return to_int(fractional_part * 100.0); // Convert fractional part to percentage
-        }
-
-        current = current[path[x]]["subskills"];
-    }
-
-    return null; // Return null if the skill was not found
+    return to_int(fractional_part * 100.0); // Convert fractional part to percentage
 }
 
 int modify_skill_level(string skill, int level) {
-    string *path = explode(skill, ".");
-    mapping current = skills;
-    int x, sz;
+    mapping index;
 
     if(!stringp(skill) || nullp(level))
         return null;
 
-    sz = sizeof(path);
-    for(x = 0; x < sz; x++) {
-        if(!mapp(current[path[x]]))
-            return 0;
-        if(x == sz - 1) {
-            current[path[x]]["level"] = level;
-            return 1;
-        }
-        current = current[path[x]]["subskills"];
-    }
+    index = skill_index();
+    if(!of(skill, index))
+        return 0;
 
-    return null;
+    index[skill] = level;
+    _skill_tree_stale = 1;
+
+    return 1;
 }
 
 /**
@@ -348,34 +396,26 @@ public int adjust_skills_by_npc_level(float level) {
         return 0; // No skills to adjust
     }
 
-    adjust_skill_levels(skills);
+    adjust_skill_levels(skill_index());
 
     return 1;
 }
 
 /**
- * @description Helper function to adjust skill levels recursively.
- * @param {mapping} current_skills - The current mapping of skills to adjust.
- * @param {float} new_level - The new level to set for each skill.
+ * @description Helper function to adjust skill levels.
+ * @param {mapping} index - The flat skill index to adjust.
  */
-private nomask mapping adjust_skill_levels(mapping current_skills) {
-    string skill;
-    mixed skill_data;
-
+private nomask mapping adjust_skill_levels(mapping index) {
     if(userp())
         error("This function is only intended for NPCs.");
 
-    foreach(skill, skill_data in current_skills) {
-        if(mapp(skill_data) && mapp(skill_data["subskills"])) {
-            // If there are subskills, recurse into them
-            adjust_skill_levels(skill_data["subskills"]);
-        }
+    // Set the skill level
+    foreach(string skill in keys(index))
+        index[skill] = random_float(0.01);
 
-        // Set the skill level
-        current_skills[skill]["level"] = random_float(0.01);
-    }
+    _skill_tree_stale = 1;
 
-    return current_skills;
+    return index;
 }
 
 /**
@@ -2,9 +2,10 @@
 // Module inherited by living objects to handle GMCP
 //
 // Created:     2024/02/22: Gesslar
-// Last Change: 2024/02/22: Gesslar
+// Last Change: 2026/10/17: Gesslar
 //
 // 2024/02/22: Gesslar - Created
+// 2026/10/17: Gesslar - Payload encoding moved to GMCP_D
 
 #include <daemons.h>
 #include <classes.h>
@@ -78,7 +79,7 @@ varargs void do_gmcp(string package, mixed data) {
         return;
 
     if(data)
-        data = json_encode(gmcp_stringify(data));
+        data = GMCP_D->encode_payload(data);
     else
         data = "";
 
@@ -90,51 +91,36 @@ varargs void do_gmcp(string package, mixed data) {
 // This funcation sanitises the data to be sent to the client. It will convert
 // the data to a string if it is not already a string. For mappings and arrays,
 // it will convert the data to a string representation of the data. GMCP should
-// always send keys and values as strings, so we convert them here.
+// always send keys and values as strings, so we convert them here. The work
+// itself is done by GMCP_D, which also encodes payloads for do_gmcp().
 mixed gmcp_stringify(mixed data) {
-    switch(typeof(data)) {
-        case T_STRING:
-            return data;
-        case T_INT:
-            return sprintf("%d", data);
-        case T_ARRAY: {
-                mixed *result;
-
-                result = map(data, (: gmcp_stringify :));
-
-                return result;
-            }
-        case T_OBJECT:
-            return "";
-        case T_MAPPING: {
-                mapping result = ([ ]);
-                mixed key, value;
-
-                foreach(key, value in data) {
-                    result[gmcp_stringify(key)] = gmcp_stringify(value);
-                }
-
-                return result;
-            }
-        case T_FUNCTION:
-            return "";
-        case T_FLOAT:
-            return sprintf("%f", data);
-        case T_BUFFER:
-            return "";
-        case T_CLASS:
-            return "";
-        default:
-            return "";
-    }
-
-    return "";
+    return GMCP_D->stringify_payload(data);
 }
 
 void clear_gmcp_data() {
     gmcp_data = ([ ]);
 }
 
+// The last values sent for each package, so that packages like Char.Vitals
+// only need to send the fields that have changed.
+mapping query_gmcp_sent(string package) {
+    if(!mapp(gmcp_data["sent"]))
+        return ([ ]);
+
+    return copy(gmcp_data["sent"][package]) || ([ ]);
+}
+
+void set_gmcp_sent(string package, mapping data) {
+    if(!mapp(gmcp_data["sent"]))
+        gmcp_data["sent"] = ([ ]);
+
+    gmcp_data["sent"][package] = data;
+}
+
+void clear_gmcp_sent() {
+    map_delete(gmcp_data, "sent");
+}
+
 void set_gmcp_client(mapping data) {
     gmcp_data["client"] = data;
 }
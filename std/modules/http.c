@@ -3,7 +3,7 @@
  * @description HTTP module with shared functions for use in HTTP operations
  *
  * @created 2024-07-05 - Gesslar
- * @last_modified 2024-12-07 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-07-05 - Gesslar - Created
@@ -12,6 +12,10 @@
  *                        Added integrity check for cached responses and
  *                        enhanced error handling for JSON decoding. Cleaned
  *                        up code for better readability.
+ * 2026-10-17 - Gesslar - Content-Length counts bytes, not characters
+ * 2026-10-17 - Gesslar - Static asset cache with ETags, conditional requests
+ *                        and a deflated variant computed once per file
+ *                        version
  */
 
 inherit M_LOG;
@@ -32,6 +36,10 @@ protected nomask void cache_response(string file, mixed response);
 protected nomask mixed read_cache(string file);
 protected nomask void set_option(string key, mixed value);
 protected nomask mixed get_option(string key);
+protected nomask string http_date(int t);
+protected nomask string http_content_type(string file);
+protected nomask mapping http_asset(string file);
+protected nomask mapping http_static_response(mapping request, string file);
 
 nomask mapping parse_http_request(buffer buf);
 nomask mapping parse_http_response(string str);
@@ -44,6 +52,28 @@ nomask mapping parse_url(string str);
 
 private nomask nosave mapping options = ([]);
 
+// file -> ([ "size", "mtime", "cost", "body", "deflate", "etag",
+//            "last-modified", "content-type" ])
+private nomask nosave mapping asset_cache = ([]);
+private nomask nosave int asset_cache_size = 0;
+
+private nomask nosave mapping content_types = ([
+  "html" : CONTENT_TYPE_TEXT_HTML,
+  "htm"  : CONTENT_TYPE_TEXT_HTML,
+  "css"  : CONTENT_TYPE_TEXT_CSS,
+  "js"   : CONTENT_TYPE_TEXT_JAVASCRIPT,
+  "mjs"  : CONTENT_TYPE_TEXT_JAVASCRIPT,
+  "json" : CONTENT_TYPE_APPLICATION_JSON,
+  "xml"  : CONTENT_TYPE_APPLICATION_XML,
+  "txt"  : CONTENT_TYPE_TEXT_PLAIN,
+  "jpg"  : CONTENT_TYPE_IMAGE_JPEG,
+  "jpeg" : CONTENT_TYPE_IMAGE_JPEG,
+  "png"  : CONTENT_TYPE_IMAGE_PNG,
+  "gif"  : CONTENT_TYPE_IMAGE_GIF,
+  "svg"  : CONTENT_TYPE_IMAGE_SVG,
+  "ico"  : CONTENT_TYPE_IMAGE_ICON,
+]);
+
 protected nomask mapping parse_http_request(buffer buf) {
   string str = to_string(buf);
   mapping result = ([ ]);
@@ -624,12 +654,181 @@ protected nomask mixed read_cache(string file) {
 }
 
 protected nomask string http_time_string(mapping client) {
-  int now = time();
-  mixed *lt = localtime(now), *gt;
+  return http_date(time());
+}
+
+protected nomask string http_date(int t) {
+  mixed *lt = localtime(t);
   int off = lt[LT_GMTOFF];
 
-  now += off + (-1 * lt[LT_ISDST]) * 3600;
-  return strftime("%a, %d %b %Y %H:%M:%S GMT", now);
+  t += off + (-1 * lt[LT_ISDST]) * 3600;
+  return strftime("%a, %d %b %Y %H:%M:%S GMT", t);
+}
+
+protected nomask string http_content_type(string file) {
+  int pos = strsrch(file, ".", -1);
+  string type;
+
+  if(pos != -1)
+    type = content_types[lower_case(file[pos+1..])];
+
+  return type || CONTENT_TYPE_APPLICATION_OCTET_STREAM;
+}
+
+// Returns the cache entry for a file, reading it (and deflating it, if it is
+// worth it) only when the file is new to the cache or has changed since.
+protected nomask mapping http_asset(string file) {
+  mixed *st = stat(file);
+  mapping entry = asset_cache[file];
+  buffer body, deflated;
+  string type, etag;
+  int size, mtime, cost;
+
+  if(!pointerp(st) || sizeof(st) < 2 || st[0] < 0) {
+    if(entry) {
+      asset_cache_size -= entry["cost"];
+      map_delete(asset_cache, file);
+    }
+
+    return 0;
+  }
+
+  size = st[0];
+  mtime = st[1];
+
+  if(entry && entry["mtime"] == mtime && entry["size"] == size)
+    return entry;
+
+  if(entry) {
+    asset_cache_size -= entry["cost"];
+    map_delete(asset_cache, file);
+  }
+
+  if(size > get_config(__MAX_BUFFER_SIZE__))
+    return 0;
+
+  body = size ? read_buffer(file, 0, size) : allocate_buffer(0);
+  if(!bufferp(body))
+    return 0;
+
+  type = http_content_type(file);
+
+  // Images and the like are compressed already.
+  if(size && (type[0..4] == "text/" || type == CONTENT_TYPE_APPLICATION_JSON ||
+     type == CONTENT_TYPE_APPLICATION_XML || type == CONTENT_TYPE_IMAGE_SVG)) {
+    deflated = compress(body);
+    if(sizeof(deflated) >= size)
+      deflated = 0;
+  }
+
+  // The entry only lives as long as this version of the file, so a hash of
+  // the content makes a strong validator. Content that isn't text falls
+  // back to the size and time.
+  if(catch(etag = hash("sha1", to_string(body))) || !etag)
+    etag = sprintf("%x-%x", size, mtime);
+  else
+    etag = etag[0..15];
+
+  cost = size + sizeof(deflated);
+
+  entry = ([
+    "size"          : size,
+    "mtime"         : mtime,
+    "cost"          : cost,
+    "body"          : body,
+    "deflate"       : deflated,
+    "etag"          : "\"" + etag + "\"",
+    "last-modified" : http_date(mtime),
+    "content-type"  : type,
+  ]);
+
+  // Very large files are served but not kept.
+  if(cost > HTTP_ASSET_CACHE_MAX / 4)
+    return entry;
+
+  if(asset_cache_size + cost > HTTP_ASSET_CACHE_MAX) {
+    asset_cache = ([]);
+    asset_cache_size = 0;
+  }
+
+  asset_cache[file] = entry;
+  asset_cache_size += cost;
+
+  return entry;
+}
+
+// Builds the response for a static file. A request whose If-None-Match or
+// If-Modified-Since still matches the file gets a bodyless 304. Otherwise
+// the deflated variant is sent when the client accepts it.
+// The deflated variant has its own strong ETag, the identity tag with a
+// "-deflate" suffix. The suffix is stripped before If-None-Match is compared,
+// so either tag revalidates the file.
+// If-Modified-Since is compared with the Last-Modified value exactly, which
+// is what clients send back.
+protected nomask mapping http_static_response(mapping request, string file) {
+  mapping entry = http_asset(file);
+  mapping headers = request["headers"] || ([]);
+  mapping response_headers;
+  mixed match, accepts;
+  int deflate;
+  string etag;
+
+  if(!entry)
+    return ([
+      "status": HTTP_STATUS_NOT_FOUND,
+      "content-type": CONTENT_TYPE_TEXT_PLAIN,
+    ]);
+
+  accepts = headers["accept-encoding"];
+  deflate = entry["deflate"] && pointerp(accepts) &&
+    sizeof(filter(accepts, (: $1 == "deflate" || $1[0..7] == "deflate;" :)));
+
+  etag = entry["etag"];
+  if(deflate)
+    etag = etag[0..<2] + "-deflate\"";
+
+  response_headers = ([
+    "ETag": etag,
+    "Last-Modified": entry["last-modified"],
+    "Cache-Control": "no-cache",
+    "Vary": "Accept-Encoding",
+  ]);
+
+  match = headers["if-none-match"];
+  if(stringp(match)) {
+    string *tags = map(explode(match, ","), (: trim :));
+
+    tags = map(tags, (: $1[0..1] == "W/" ? $1[2..] : $1 :));
+    tags = map(tags, (: $1[<9..] == "-deflate\"" ? $1[0..<10] + "\"" : $1 :));
+    if(match == "*" || member_array(entry["etag"], tags) != -1)
+      return ([
+        "status": HTTP_STATUS_NOT_MODIFIED,
+        "content-type": entry["content-type"],
+        "headers": response_headers,
+      ]);
+  } else if(headers["if-modified-since"] == entry["last-modified"]) {
+    return ([
+      "status": HTTP_STATUS_NOT_MODIFIED,
+      "content-type": entry["content-type"],
+      "headers": response_headers,
+    ]);
+  }
+
+  if(deflate)
+    return ([
+      "status": HTTP_STATUS_OK,
+      "content-type": entry["content-type"],
+      "content-encoding": "deflate",
+      "body": entry["deflate"],
+      "headers": response_headers,
+    ]);
+
+  return ([
+    "status": HTTP_STATUS_OK,
+    "content-type": entry["content-type"],
+    "body": entry["body"],
+    "headers": response_headers,
+  ]);
 }
 
 protected nomask int http_content_length(mapping client) {
@@ -649,7 +848,7 @@ protected nomask int http_content_length(mapping client) {
   if(!bufferp(buf))
     return -1;
 
-  return sizeof(body);
+  return sizeof(buf);
 }
 
 protected nomask void set_option(string key, mixed value) {
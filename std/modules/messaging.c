@@ -123,8 +123,28 @@ varargs receive_direct(string msg, int message_type) {
     do_receive(msg, message_type);
 }
 
+// Renders a message for delivery according to the colour mode, accent
+// colour and line-drawing encoding that make up the recipient's profile.
+private string render_message(string message, int message_type, string term, string encoding) {
+    if(!(message_type & NO_COLOUR))
+        message = COLOUR_D->body_colour_replace(this_object(), message, message_type);
+
+    // If NO_COLOUR flag is set, substitute colours with "off" (i.e., no
+    // colour).
+    if(message_type & NO_COLOUR) {
+        message = COLOUR_D->substitute_colour(message, "off");
+    } else {
+        message = COLOUR_D->substitute_colour(message, term);
+    }
+
+    if(encoding)
+        message = LINES_D->substitute_lines(message, encoding);
+
+    return message;
+}
+
 void do_receive(string message, int message_type) {
-    string term;
+    string term, encoding, accent, profile, rendered;
 
     if(userp()) {
         term = this_object()->query_pref("colour");
@@ -144,24 +164,19 @@ void do_receive(string message, int message_type) {
                 break;
         }
 
-        if(!(message_type & NO_COLOUR))
-            message = COLOUR_D->body_colour_replace(this_object(), message, message_type);
+        // Combat messages may be wrapped in the body's own accent colour.
+        if(!(message_type & NO_COLOUR)) {
+            if(message_type & MSG_COMBAT_HIT)
+                accent = this_object()->query_pref("combat_hit_colour");
+            else if(message_type & MSG_COMBAT_MISS)
+                accent = this_object()->query_pref("combat_miss_colour");
+        }
     } else {
         // For non-user objects, also disable coloured messages.
         message_type |= NO_COLOUR;
     }
 
-    // If NO_COLOUR flag is set, substitute colours with "off" (i.e., no
-    // colour).
-    if(message_type & NO_COLOUR) {
-        message = COLOUR_D->substitute_colour(message, "off");
-    } else {
-        message = COLOUR_D->substitute_colour(message, term);
-    }
-
     if(function_exists("query_environ")) {
-        string encoding;
-
         if(query_environ("SCREEN_READER")) {
             encoding = "screenreader";
         } else if(query_environ("UTF-8")) {
@@ -169,10 +184,24 @@ void do_receive(string message, int message_type) {
         } else {
             encoding = "US-ASCII";
         }
+    }
 
-        message = LINES_D->substitute_lines(message, encoding);
+    // Everyone sharing a profile sees the same bytes, so during a broadcast
+    // the message is only rendered once per profile.
+    profile = sprintf("%s:%s:%s",
+        (message_type & NO_COLOUR) ? "off" : term,
+        encoding || "",
+        stringp(accent) ? accent : ""
+    );
+
+    rendered = query_broadcast_render(message, profile);
+    if(!rendered) {
+        rendered = render_message(message, message_type, term, encoding);
+        set_broadcast_render(message, profile, rendered);
     }
 
+    message = rendered;
+
     // if(!(message_type & MSG_PROMPT)) {
     //     message = append(message, "\n");
     // }
@@ -2,12 +2,15 @@
 // Module to handle persistent saving of data
 //
 // Created:     2024/02/02: Gesslar
-// Last Change: 2024/02/02: Gesslar
+// Last Change: 2026/10/17: Gesslar
 //
 // 2024/02/02: Gesslar - Created
+// 2026/10/17: Gesslar - Added dirty tracking
+// 2026/10/17: Gesslar - Always tell the persist daemon when marked dirty
 
 private nosave int persistent = 0;
 private nosave string data_file = 0;
+private nosave int dirty = 0;
 
 varargs string set_data_file(string file);
 
@@ -29,6 +32,21 @@ int query_persistent() {
     return persistent;
 }
 
+// flag this object's saved state as changed, so that the persist daemon
+// writes it on its next flush. The daemon is told every time, since it may
+// have been reloaded and lost track of us since we were last marked.
+void mark_dirty() {
+    if(!persistent)
+        return;
+
+    dirty = 1;
+    PERSIST_D->mark_dirty(this_object());
+}
+
+int query_dirty() {
+    return dirty;
+}
+
 // the save file, if none, provided, the object will determine its own
 // save file based on the master_object() to be backwards compatible with
 // old save.c
@@ -72,7 +90,15 @@ int save_data() {
             if(!assure_dir(base))
                 return 0;
 
-    return save_object(data_file);
+    if(!save_object(data_file))
+        return 0;
+
+    if(dirty) {
+        dirty = 0;
+        PERSIST_D->mark_clean(this_object());
+    }
+
+    return 1;
 }
 
 int restore_data() {
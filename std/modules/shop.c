@@ -2,11 +2,16 @@
  * @file /std/modules/shop.c
  * @description Module to be inherited by shops
  *
+ * Stock is held by the store as records (see STD_STORAGE_OBJECT). Listing
+ * works from the records alone, and an item is only cloned when it is
+ * bought or looked at.
+ *
  * @created 2024-08-01 - Gesslar
- * @last_modified 2024-08-01 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-08-01 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Record-based stock
  */
 
 #include <classes.h>
@@ -18,7 +23,7 @@ inherit M_CURRENCY;
 inherit CLASS_STORAGE;
 
 void add_shop_inventory(mixed args);
-int query_cost(object tp, object ob, string transaction);
+int query_cost(object tp, mixed item, string transaction);
 protected void remove_shop();
 protected void reset_shop();
 private nomask object create_storage();
@@ -62,76 +67,56 @@ protected void reset_shop() {
 
   create_storage();
   store->clean_contents();
-return;
+  store->clear_records();
+
   foreach(arg in shop_inventory) {
-    string file;
-    int number;
-    mixed *clone_args;
-    int sz;
-    object ob;
+    int number = 1;
 
     if(!pointerp(arg))
       arg = ({ arg });
 
-    sz = sizeof(arg);
-
-    file = arg[0];
-    if(!stringp(file))
+    if(!stringp(arg[0]))
       continue;
 
-    sz = 0;
-
-    if(sz > 1) {
+    if(sizeof(arg) > 1 && intp(arg[1]))
       number = arg[1];
-      if(sz > 2)
-        clone_args = clone_args[2..];
-      else
-        number = 1;
-    }
-
-    while(number--) {
-      string e;
 
-      e = catch {
-        if(sizeof(clone_args))
-          ob = new(file, clone_args...);
-        else
-          ob = new(file);
-      };
-
-      if(e) {
-        log_file("shop_errors", e);
-        continue;
-      }
-
-      if(!objectp(ob))
-        continue;
-
-      if(ob->move(store))
-        ob->remove();
-    }
+    store->stock(arg[0], number);
   }
 }
 
-mixed cmd_list(object tp) {
-  object *items, item;
-  string *lines = ({});
-  string line;
+mixed cmd_list(object tp, string str) {
+  string *lines;
+  string key;
+  mapping record;
   object ob;
-  string short;
-  int cost;
 
   create_storage();
 
-  items = all_inventory(store);
+  // Looking at one item clones it just long enough to describe it.
+  if(str) {
+    if(!key = store->find_record(str))
+      return "The shop does not have that item.";
+
+    if(!ob = store->clone_record(key))
+      return "The shop does not have that item.";
+
+    lines = ({ get_short(ob) + sprintf(" (%d)", query_cost(tp, store->query_record(key), "list")), "" });
+    lines += explode(ob->query_long() || "", "\n");
+    ob->remove();
+
+    return lines;
+  }
 
   lines = ({ get_short(), "" });
 
-  foreach(item in items) {
-    cost = query_cost(tp, item, "list");
-    short = get_short(item);
-    line = sprintf("%s (%d)", short, cost);
-    lines += ({ line });
+  foreach(key in store->query_record_keys()) {
+    record = store->query_record(key);
+
+    if(record["count"] > 1)
+      lines += ({ sprintf("%s (%d) [%d]", record["short"], query_cost(tp, record, "list"), record["count"]) });
+    else
+      lines += ({ sprintf("%s (%d)", record["short"], query_cost(tp, record, "list")) });
   }
 
   return lines;
@@ -139,6 +124,7 @@ mixed cmd_list(object tp) {
 
 mixed cmd_buy(object tp, string str) {
   object ob;
+  string key;
   mixed result;
   string action;
   mixed cost;
@@ -156,17 +142,17 @@ mixed cmd_buy(object tp, string str) {
   if(!userp(tp))
     return "Only players can buy from the shop.";
 
-  if(!ob = present(str, store))
+  if(!key = store->find_record(str))
     return "The shop does not have that item.";
 
-  cost = query_cost(tp, ob, "buy");
+  cost = query_cost(tp, store->query_record(key), "buy");
 
   result = handle_transaction(tp, cost);
 
   if(stringp(result))
     return result;
 
-  if(ob->move(tp)) {
+  if(!ob = store->withdraw(key, tp)) {
     reverse_transaction(tp, result);
 
     return "You can't carry that much weight.";
@@ -252,7 +238,7 @@ mixed cmd_sell(object tp, string str) {
       }
     }
 
-    if(ob->move(store)) {
+    if(!store->deposit(ob)) {
       tell(tp, "The shop refuses to buy your " + short + ".\n");
       continue;
     }
@@ -276,8 +262,14 @@ mixed cmd_sell(object tp, string str) {
   return 1;
 }
 
-int query_cost(object tp, object ob, int transaction) {
-  int value = ob->query_value();
+int query_cost(object tp, mixed item, string transaction) {
+  int value;
+
+  // Stock is priced from its record; anything else is a real object.
+  if(mapp(item))
+    value = item["value"];
+  else
+    value = item->query_value();
 
   switch(transaction) {
     case "buy":
@@ -288,7 +280,7 @@ int query_cost(object tp, object ob, int transaction) {
       return value;
   }
 
-  return ob->query_value();
+  return value;
 }
 
 private nomask object create_storage() {
@@ -240,7 +240,7 @@ nomask varargs string *query_command_history(int index, int range) {
 }
 
 int command_hook(string arg) {
-  string verb, err, *cmds = ({});
+  string verb, err, *cmds;
   string custom, tmp;
   object
   /** @type {STD_PLAYER} @type {STD_NPC}*/ caller,
@@ -249,7 +249,7 @@ int command_hook(string arg) {
   /** @type {STD_ITEM}* @type {STD_OBJECT}* */ *obs;
   int i;
   mixed result;
-  string complete;
+  string complete, parsed;
 
   caller = this_body();
 
@@ -259,8 +259,9 @@ int command_hook(string arg) {
 
   verb = query_verb();
 
-  if(sscanf(alias_parse(verb, arg), "%s %s", verb, arg) != 2)
-    verb = alias_parse(verb, arg);
+  parsed = alias_parse(verb, arg);
+  if(sscanf(parsed, "%s %s", verb, arg) != 2)
+    verb = parsed;
 
   if(arg == "")
     arg = 0;
@@ -316,9 +317,7 @@ int command_hook(string arg) {
         return 1;
   };
 
-  for(i = 0; i < sizeof(_path); i ++)
-    if(file_exists(_path[i] + verb + ".c"))
-      cmds += ({ _path[i] + verb });
+  cmds = COMMAND_D->resolve_command(_path, verb);
 
   if(sizeof(cmds) > 0) {
     mixed return_value;
@@ -4,11 +4,12 @@
  *              inventory management and mass/capacity tracking.
  *
  * @created 2024-02-18 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-02-18 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Added documentation
+ * 2026-10-17 - Gesslar - Index of the livings and players present
  */
 
 #include <contents.h>
@@ -21,6 +22,13 @@
 private int _capacity;
 private nosave int _fill;
 
+/**
+ * Livings present in this container, kept up to date by move() so that
+ * looking for livings or players does not mean scanning every item here.
+ * Newest arrivals come first, matching the order of all_inventory().
+ */
+private nosave object *_present_livings = ({ });
+
 /**
  * Removes all objects from this container recursively.
  *
@@ -204,3 +212,63 @@ void rehash_capacity() {
     );
   }
 }
+
+/**
+ * Records a living as having entered this container. Called by move().
+ *
+ * @param {object} ob - The living that arrived
+ */
+void add_present_living(object ob) {
+  if(!objectp(ob) || !living(ob))
+    return;
+
+  _present_livings = ({ ob }) + (_present_livings - ({ ob }));
+}
+
+/**
+ * Records a living as having left this container. Called by move().
+ *
+ * @param {object} ob - The living that left
+ */
+void remove_present_living(object ob) {
+  _present_livings -= ({ ob });
+}
+
+/**
+ * Drops entries that are no longer valid, such as livings that have been
+ * destructed, moved without going through move(), or stopped being living.
+ */
+private void prune_present_livings() {
+  object ob = this_object();
+
+  _present_livings = filter(_present_livings, (:
+    objectp($1) && living($1) && environment($1) == $(ob)
+  :));
+}
+
+/**
+ * Returns the livings directly inside this container.
+ *
+ * @returns {object*} The livings present
+ */
+object *query_present_livings() {
+  prune_present_livings();
+
+  return copy(_present_livings);
+}
+
+/**
+ * Returns the players directly inside this container.
+ *
+ * @returns {object*} The players present
+ */
+object *query_present_players() {
+  return filter(query_present_livings(), (: userp :));
+}
+
+/**
+ * Rebuilds the index of livings present from the actual inventory.
+ */
+void rehash_present_livings() {
+  _present_livings = filter(all_inventory(), (: living($1) :));
+}
@@ -59,10 +59,33 @@ int add_cooldown(string id, int cooldown) {
     return null;
 
   _cooldowns[id] = time() + cooldown;
+  SCHEDULER_D->schedule(cooldown, "expire_cooldown", id);
 
   return query_cooldown(id);
 }
 
+/**
+ * Removes a cooldown once it has expired. Scheduled by add_cooldown() so
+ * that objects without a heart beat do not accumulate stale cooldowns. If
+ * the cooldown was extended in the meantime, it is checked again when the
+ * new expiry comes around.
+ *
+ * @param {string} id - The cooldown identifier
+ */
+void expire_cooldown(string id) {
+  int time = query_cooldown(id);
+
+  if(!time)
+    return;
+
+  if(time > time()) {
+    SCHEDULER_D->schedule(time - time(), "expire_cooldown", id);
+    return;
+  }
+
+  map_delete(_cooldowns, id);
+}
+
 /**
  * Removes a cooldown.
  *
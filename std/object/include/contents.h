@@ -10,5 +10,10 @@ int query_capacity() ;
 int adjust_fill(int x) ;
 int can_hold_object(object ob) ;
 int can_hold_mass(int mass) ;
+void add_present_living(object ob) ;
+void remove_present_living(object ob) ;
+object *query_present_livings() ;
+object *query_present_players() ;
+void rehash_present_livings() ;
 
 #endif // __CONTENTS_H__
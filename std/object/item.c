@@ -4,11 +4,12 @@
  *              manipulated, carried, and moved between containers.
  *
  * @created 2024-07-27 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-07-27 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Added documentation
+ * 2026-10-17 - Gesslar - Keep the environment's index of livings current
  */
 
 #include <gmcp_defines.h>
@@ -216,6 +217,12 @@ int move(mixed dest) {
   // Ok, we can move now.
   move_object(dest);
 
+  if(living()) {
+    if(prev)
+      call_if(prev, "remove_present_living", this_object());
+    call_if(environment(), "add_present_living", this_object());
+  }
+
   event(this_object(), "moved", prev);
   if(prev && this_object()) {
     event(prev, "released", environment());
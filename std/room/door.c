@@ -6,11 +6,12 @@
  * properties and state.
  *
  * @created 2024-09-13 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-09-13 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Enhanced documentation
+ * 2026-10-17 - Gesslar - Invalidate the cached Room.Info on door changes
  */
 
 #include <classes.h>
@@ -20,6 +21,8 @@
 
 inherit CLASS_DOOR;
 
+void invalidate_room_info();
+
 private nosave mapping _doors = ([ ]);
 
 /**
@@ -65,6 +68,7 @@ int add_door(class Door door) {
   door.id += ({ door.name, door.type, lower_case(door.short) });
 
   _doors[door.direction] = door;
+  invalidate_room_info();
 
   GMCP_D->broadcast_gmcp(this_object(), GMCP_PKG_ROOM_INFO, this_object());
 
@@ -101,6 +105,7 @@ int remove_door(string direction) {
     return null;
 
   map_delete(_doors, direction);
+  invalidate_room_info();
 
   GMCP_D->broadcast_gmcp(this_object(), GMCP_PKG_ROOM_INFO, this_object());
 
@@ -128,6 +133,7 @@ varargs int set_door_open(string direction, int bool, int silent) {
   door.status = bool ? "open" : "closed";
 
   _doors[direction] = door;
+  invalidate_room_info();
 
   if(!silent)
     tell_down(this_object(),
@@ -188,6 +194,7 @@ int set_door_locked(string direction, int bool, int silent) {
       sprintf("There is a click from the %s.\n", door.name));
 
   _doors[direction] = door;
+  invalidate_room_info();
 
   GMCP_D->broadcast_gmcp(this_object(), GMCP_PKG_ROOM_INFO, this_object());
 
@@ -226,6 +233,7 @@ int add_door_id(string direction, string id) {
   door.id = distinct_array(door.id);
 
   _doors[direction] = door;
+  invalidate_room_info();
 
   return 1;
 }
@@ -246,6 +254,7 @@ int remove_door_id(string direction, string id) {
   door.id = remove_array_element(door.id, id);
 
   _doors[direction] = door;
+  invalidate_room_info();
 
   return 1;
 }
@@ -275,6 +284,7 @@ int set_door_short(string direction, string short) {
   door.short = short;
 
   _doors[direction] = door;
+  invalidate_room_info();
 
   return 1;
 }
@@ -310,6 +320,7 @@ int set_door_long(string direction, string long) {
   door.long = long;
 
   _doors[direction] = door;
+  invalidate_room_info();
 
   return 1;
 }
@@ -3,15 +3,18 @@
  * @description Exits are the connections between rooms.
  *
  * @created 2024-09-13 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-09-13 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Added documentation
+ * 2026-10-17 - Gesslar - Invalidate the cached Room.Info on exit changes
  */
 
 #include <exits.h>
 
+void invalidate_room_info();
+
 private nosave mapping _exits = ([]);
 private nosave mapping _pre_exit_funcs = ([]);
 private nosave mapping _post_exit_funcs = ([]);
@@ -24,6 +27,7 @@ private nosave mapping _post_exit_funcs = ([]);
  */
 mapping set_exits(mapping exit) {
   _exits = exit;
+  invalidate_room_info();
 
   return query_exits();
 }
@@ -144,6 +148,7 @@ mapping remove_exit(string id) {
     return query_exits();
 
   map_delete(_exits, id);
+  invalidate_room_info();
 
   return query_exits();
 }
@@ -157,6 +162,7 @@ mapping remove_exit(string id) {
  */
 mapping add_exit(string id, string path) {
   _exits[id] = path;
+  invalidate_room_info();
 
   return query_exits();
 }
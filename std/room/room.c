@@ -3,11 +3,12 @@
  * @description A generic room object that can be inherited by any room.
  *
  * @created 2024-08-11 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-08-11 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Added documentation
+ * 2026-10-17 - Gesslar - Cache the GMCP Room.Info payload
  */
 
 #include <room.h>
@@ -46,37 +47,60 @@ private nosave int room_colour = null;
 private nosave mapping custom_gmcp = ([ ]);
 private nosave int no_gmcp_room_info = 0;
 
+private nosave mapping _room_info = null;
+private nosave string _room_info_short = null;
+private nosave int _room_info_coords = 0;
+
+/**
+ * Drops the cached GMCP room information so it is rebuilt on next use.
+ * Called whenever anything that goes into it changes.
+ */
+void invalidate_room_info() {
+  _room_info = null;
+}
+
 /**
  * Generates room information for GMCP protocol.
  *
  * Creates a data structure containing all relevant room information
  * including exits, doors, environment, coordinates, and custom data.
  *
+ * The result is built once and kept until an exit, door, terrain or other
+ * room setting changes, the short description changes, or the coordinate
+ * data is replaced. Every caller gets the same mapping, which must not be
+ * modified. Rooms with function exits are rebuilt on every call, since
+ * their destinations may change at any time.
+ *
  * @param {object} who - The player for whom the GMCP data is being generated
  * @returns {mapping} Mapping with room information
  */
 mapping gmcp_room_info(object who) {
-  mapping info = ([ ]);
   string *exit_dirs;
-  string *door_dirs;
   mapping exits;
   mapping doors;
   mapping result;
   mapping gmcp_info = ([ ]);
-  // string *suppress;
+  string short;
+  int coords_generation;
+  int volatile;
 
   if(no_gmcp_room_info)
-    return info;
+    return ([ ]);
+
+  short = query_short();
+  coords_generation = COORD_D->query_generation();
+
+  if(_room_info &&
+     short == _room_info_short &&
+     coords_generation == _room_info_coords)
+    return _room_info;
 
   exit_dirs = query_exit_ids();
-  door_dirs = query_door_ids();
 
   exits = query_exits();
-  // suppress = query_exit_suppress() || ({});
-  // exits = filter(exits, (: member_array($1, $(suppress)) == -1 :));
+  volatile = sizeof(filter(values(exits), (: valid_function :)));
   exits = allocate_mapping(exit_dirs, (: query_exit :));
-  exits = map(exits, (: base_name($2) :));
-  exits = map(exits, (: hash("md4", $2) :));
+  exits = map(exits, (: hash("md4", base_name($2)) :));
 
   doors = query_doors();
   doors = map(doors, function(string dir, class Door door) {
@@ -93,7 +117,7 @@ mapping gmcp_room_info(object who) {
   result = ([
     "area"       : query_zone_name(),
     "hash"       : hash("md4", base_name()),
-    "name"       : no_ansi(query_short()),
+    "name"       : no_ansi(short),
     "exits"      : exits,
     "doors"      : doors,
     "environment": query_room_environment() || query_terrain(),
@@ -111,6 +135,13 @@ mapping gmcp_room_info(object who) {
   if(sizeof(gmcp_info))
     result["custom"] = gmcp_info;
 
+  if(volatile)
+    return result;
+
+  _room_info = result;
+  _room_info_short = short;
+  _room_info_coords = coords_generation;
+
   return result;
 }
 
@@ -122,7 +153,11 @@ mapping gmcp_room_info(object who) {
  * @param {string} environment - The environment type
  * @returns {string} The new environment
  */
-string set_room_environment(string environment) { room_environment = environment; }
+string set_room_environment(string environment) {
+  invalidate_room_info();
+
+  return room_environment = environment;
+}
 
 /**
  * Returns the room's environment setting.
@@ -137,7 +172,11 @@ string query_room_environment() { return room_environment; }
  * @param {int} colour - The color value
  * @returns {int} The new color value
  */
-int set_room_colour(int colour) { room_colour = colour; }
+int set_room_colour(int colour) {
+  invalidate_room_info();
+
+  return room_colour = colour;
+}
 
 /**
  * Returns the room's color setting.
@@ -155,6 +194,7 @@ int query_room_colour() { return room_colour; }
  */
 void set_room_size(int *size) {
   _size = size;
+  invalidate_room_info();
 }
 
 /**
@@ -242,6 +282,7 @@ int *get_virtual_coordinates() {
  */
 void set_no_gmcp_room_info(int no_gmcp) {
   no_gmcp_room_info = no_gmcp;
+  invalidate_room_info();
 }
 
 /**
@@ -252,6 +293,7 @@ void set_no_gmcp_room_info(int no_gmcp) {
  */
 void add_custom_gmcp(string key, mixed value) {
   custom_gmcp[key] = value;
+  invalidate_room_info();
 }
 
 /**
@@ -261,6 +303,7 @@ void add_custom_gmcp(string key, mixed value) {
  */
 void remove_custom_gmcp(string key) {
   map_delete(custom_gmcp, key);
+  invalidate_room_info();
 }
 
 /**
@@ -276,7 +319,11 @@ mapping query_custom_gmcp() { return custom_gmcp; }
  * @param {string} type - The room type
  * @returns {string} The new room type
  */
-string set_room_type(string type) { return room_type = type; }
+string set_room_type(string type) {
+  invalidate_room_info();
+
+  return room_type = type;
+}
 
 /**
  * Sets the room's subtype.
@@ -284,7 +331,11 @@ string set_room_type(string type) { return room_type = type; }
  * @param {string} subtype - The room subtype
  * @returns {string} The new room subtype
  */
-string set_room_subtype(string subtype) { return room_subtype = subtype; }
+string set_room_subtype(string subtype) {
+  invalidate_room_info();
+
+  return room_subtype = subtype;
+}
 
 /**
  * Sets the room's icon for map displays.
@@ -292,7 +343,11 @@ string set_room_subtype(string subtype) { return room_subtype = subtype; }
  * @param {string} icon - The icon identifier
  * @returns {string} The new room icon
  */
-string set_room_icon(string icon) { return room_icon = icon; }
+string set_room_icon(string icon) {
+  invalidate_room_info();
+
+  return room_icon = icon;
+}
 
 /**
  * Returns the room's type.
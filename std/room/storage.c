@@ -4,11 +4,12 @@
  *              from this class to create a storage room.
  *
  * @created 2024-08-12 - Gesslar
- * @last_modified 2025-03-16 - GitHub Copilot
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-08-12 - Gesslar - Created
  * 2025-03-16 - GitHub Copilot - Added documentation
+ * 2026-10-17 - Gesslar - Work from the storage object's records
  */
 
 #include <classes.h>
@@ -133,15 +134,15 @@ class StorageOptions query_storage_options() {
  */
 mixed cmd_list(object tp, string arg) {
   string *list = ({});
-  object ob, next;
   object store = store();
 
-  ob = first_inventory(store);
+  foreach(string key in store->query_record_keys()) {
+    mapping record = store->query_record(key);
 
-  while(ob) {
-    next = next_inventory(ob);
-    list += ({ get_short(ob) });
-    ob = next;
+    if(record["count"] > 1)
+      list += ({ sprintf("%s [%d]", record["short"], record["count"]) });
+    else
+      list += ({ record["short"] });
   }
 
   if(sizeof(list) > 0)
@@ -183,10 +184,12 @@ mixed cmd_store(object tp, string arg) {
     return "You don't possess any such thing to store.";
 
   foreach(ob in obs) {
-    if(result = ob->move(store))
-      out += get_short(ob) + " could not be stored.\n";
+    string short = get_short(ob);
+
+    if(!store->deposit(ob))
+      out += short + " could not be stored.\n";
     else
-      out += "You store " + get_short(ob) + ".\n";
+      out += "You store " + short + ".\n";
   }
 
   if(strlen(out)) {
@@ -209,31 +212,44 @@ mixed cmd_store(object tp, string arg) {
  * @returns {string} Result message
  */
 mixed cmd_take(object tp, string arg) {
-  object ob, *obs;
+  string *keys;
   string out = "";
-  int result;
+  int all = 1;
   object store = store();
 
   if(!arg)
     return "Usage: take <item|all|all <item>>";
 
   if(arg == "all")
-    obs = all_inventory(store);
+    keys = store->query_record_keys();
   else if(sscanf(arg, "all %s", arg))
-    obs = filter(all_inventory(store), (: $1->id($2) :), arg);
-  else
-    obs = ({ present(arg, store) });
+    keys = filter(store->query_record_keys(),
+      (: member_array($2, $(store)->query_record($1)["ids"]) != -1 :), arg);
+  else {
+    keys = ({ store->find_record(arg) });
+    all = 0;
+  }
 
-  obs -= ({ 0 });
+  keys -= ({ 0 });
 
-  if(!sizeof(obs))
+  if(!sizeof(keys))
     return "There is no such item in storage.";
 
-  foreach(ob in obs) {
-    if((result = ob->move(tp)))
-      out += get_short(ob) + " could not be taken.\n";
-    else
+  // "all" takes every item of a record, otherwise just the one.
+  foreach(string key in keys) {
+    int count = all ? store->query_record(key)["count"] : 1;
+    string short = store->query_record(key)["short"];
+
+    while(count--) {
+      object ob = store->withdraw(key, tp);
+
+      if(!ob) {
+        out += short + " could not be taken.\n";
+        break;
+      }
+
       out += "You take " + get_short(ob) + " from storage.\n";
+    }
   }
 
   if(strlen(out)) {
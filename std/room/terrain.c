@@ -3,12 +3,15 @@
  * @description Terrain types
  *
  * @created 2024-08-19 - Gesslar
- * @last_modified 2024-08-19 - Gesslar
+ * @last_modified 2026-10-17 - Gesslar
  *
  * @history
  * 2024-08-19 - Gesslar - Created
+ * 2026-10-17 - Gesslar - Invalidate the cached Room.Info on terrain changes
  */
 
+void invalidate_room_info();
+
 private nosave string *_terrain_types = ({
     "city",
     "road",
@@ -30,6 +33,7 @@ void set_terrain(string terrain) {
         return;
 
     _terrain = terrain;
+    invalidate_room_info();
 }
 
 string query_terrain() {
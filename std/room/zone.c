@@ -3,14 +3,16 @@
  * @description Room zone module
  *
  * @created 2024/02/04 - Gesslar
- * @last_modified 2024/02/04 - Gesslar
+ * @last_modified 2026/10/17 - Gesslar
  *
  * @history
  * 2024/02/04 - Gesslar - Created
+ * 2026/10/17 - Gesslar - Invalidate the cached Room.Info on zone changes
  */
 
 
 string find_path(string path);
+void invalidate_room_info();
 
 private nosave object zone;
 
@@ -28,6 +30,7 @@ void set_zone(mixed z) {
 
   zone = z;
   zone->add_room(this_object());
+  invalidate_room_info();
 }
 
 string query_zone_name() {